@@ -11,82 +11,1092 @@
 #include <stdbool.h>
 #include <stddef.h>             // size_t
 #include <stdint.h>
-#include <stdlib.h>             // strtoull
-#include <string.h>             // strncmp
+#include <stdio.h>              // fflush, fwrite
+#include <stdlib.h>             // strtoull, calloc, realloc, free, qsort
+#include <string.h>             // memcmp, memset, strcmp, strcspn, strlen, strncmp, strnlen
 
 #include "common.h"
+#include "main.h"
+#include "pack.h"
+#include "regdb.h"
+#include "serve.h"
+#include "trace.h"
 #include "util.h"
 #include "recfg.h"
 
-enum
-{
-    kFlagSearch = 0x1,
-};
+#define CARVE_CHUNK 0x100000
+#define CARVE_MAX   0x40000     // Same baseless assumption as search(), that sequences are shorter than 0x10000 words
+#define CARVE_FAIL  UINT32_MAX
+#define JOB_BATCH   0x100
+#define SERVE_MAXMEM 0x10000000
 
-typedef struct
+// Set once before any walking starts, read-only afterwards.
+static const regdb_t *symdb = NULL;
+
+#define OUT(str, args...) buf_printf(a, str, ##args)
+
+// Ends an op line, annotating it with register names if we have any.
+static void recfg_eol(buf_t *out, uint64_t addr, uint64_t val, uint64_t mask)
 {
-    size_t off;
-    size_t len;
-    uint32_t flags;
-} recfg_arg_t;
+    if(symdb) regdb_annotate(symdb, out, addr, val, mask);
+    buf_printf(out, "\n");
+}
 
 static int recfg_end_cb(void *a)
 {
-    LOG("end\n"); // Intentional newline
+    OUT("end\n\n"); // Intentional newline
     return kRecfgSuccess;
 }
 
 static int recfg_delay_cb(void *a, uint32_t *delay)
 {
-    LOG("delay %d", *delay);
+    OUT("delay %d\n", *delay);
     return kRecfgSuccess;
 }
 
 static int recfg_read32_cb(void *a, uint64_t *addr, uint32_t *mask, uint32_t *data, bool *retry, uint8_t *recnt)
 {
-    if(*retry)  LOG("rd32 0x%09llx & 0x%08x == 0x%08x, retry = %d", *addr, *mask, *data, *recnt);
-    else        LOG("rd32 0x%09llx & 0x%08x == 0x%08x", *addr, *mask, *data);
+    if(*retry)  OUT("rd32 0x%09llx & 0x%08x == 0x%08x, retry = %d", *addr, *mask, *data, *recnt);
+    else        OUT("rd32 0x%09llx & 0x%08x == 0x%08x", *addr, *mask, *data);
+    recfg_eol(a, *addr, *data, *mask);
     return kRecfgSuccess;
 }
 
 static int recfg_read64_cb(void *a, uint64_t *addr, uint64_t *mask, uint64_t *data, bool *retry, uint8_t *recnt)
 {
-    if(*retry)  LOG("rd64 0x%09llx & 0x%016llx == 0x%016llx, retry = %d", *addr, *mask, *data, *recnt);
-    else        LOG("rd64 0x%09llx & 0x%016llx == 0x%016llx", *addr, *mask, *data);
+    if(*retry)  OUT("rd64 0x%09llx & 0x%016llx == 0x%016llx, retry = %d", *addr, *mask, *data, *recnt);
+    else        OUT("rd64 0x%09llx & 0x%016llx == 0x%016llx", *addr, *mask, *data);
+    recfg_eol(a, *addr, *data, *mask);
     return kRecfgSuccess;
 }
 
 static int recfg_write32_cb(void *a, uint64_t *addr, uint32_t *data)
 {
-    LOG("wr32 0x%09llx = 0x%08x", *addr, *data);
+    OUT("wr32 0x%09llx = 0x%08x", *addr, *data);
+    recfg_eol(a, *addr, *data, 0xffffffff);
     return kRecfgSuccess;
 }
 
 static int recfg_write64_cb(void *a, uint64_t *addr, uint64_t *data)
 {
-    LOG("wr64 0x%llx = 0x%016llx", *addr, *data);
+    OUT("wr64 0x%llx = 0x%016llx", *addr, *data);
+    recfg_eol(a, *addr, *data, ~0ULL);
     return kRecfgSuccess;
 }
 
-static int recfg_do_range(char *mem, size_t size, char *base)
+#undef OUT
+
+const recfg_cb_t recfg_print_cb =
+{
+    .generic = NULL,
+    .end     = recfg_end_cb,
+    .delay   = recfg_delay_cb,
+    .r32     = recfg_read32_cb,
+    .r64     = recfg_read64_cb,
+    .w32     = recfg_write32_cb,
+    .w64     = recfg_write64_cb,
+};
+
+enum
 {
-    size_t err = 0;
-    if(recfg_check(mem, size, &err, true) != kRecfgSuccess)
+    kJobHdrNone     = 0,
+    kJobHdrSeq      = 1, // "# hdr_a hdr_b"
+    kJobHdrImage    = 2, // "## hdr_a name version", name and version taken from the image at `mem`
+};
+
+typedef struct
+{
+    char *mem;
+    size_t size;
+    bool sep;       // Print a blank line after successful output
+    bool checked;   // Whether recfg_check() passed
+    uint8_t hdr;    // kJobHdr*, formatted by job_run() so that only the current batch holds buffers
+    uint64_t hdr_a;
+    uint64_t hdr_b;
+    int ret;
+    recfg_ctx_t ctx;
+    buf_t out;
+} job_t;
+
+typedef struct
+{
+    job_t *job;
+    size_t num;
+    size_t cap;
+} job_list_t;
+
+typedef struct
+{
+    job_t *job;
+    char *base;
+    const recfg_filter_t *filter;
+} job_arg_t;
+
+static job_t* job_push(job_list_t *list, char *mem, size_t size, bool sep)
+{
+    if(list->num >= list->cap)
     {
-        ERR("Error at offset 0x%lx (sequence 0x%lx)", mem - base + err, mem - base);
+        size_t cap = list->cap ? list->cap * 2 : 0x10;
+        job_t *job = realloc(list->job, cap * sizeof(*job));
+        if(!job)
+        {
+            return NULL;
+        }
+        list->job = job;
+        list->cap = cap;
+    }
+    job_t *job = &list->job[list->num++];
+    *job = (job_t){ .mem = mem, .size = size, .sep = sep };
+    return job;
+}
+
+static void job_free(job_list_t *list)
+{
+    for(size_t i = 0; i < list->num; ++i)
+    {
+        buf_free(&list->job[i].out);
+    }
+    if(list->job) free(list->job);
+    list->job = NULL;
+    list->num = 0;
+    list->cap = 0;
+}
+
+static void job_hdr(job_t *job)
+{
+    switch(job->hdr)
+    {
+        case kJobHdrSeq:
+            buf_printf(&job->out, "# 0x%llx 0x%llx\n", job->hdr_a, job->hdr_b);
+            break;
+        case kJobHdrImage:
+            {
+                const char *name = job->mem + 0x200,
+                           *vers = job->mem + 0x280;
+                buf_printf(&job->out, "## 0x%llx %.*s %.*s\n", job->hdr_a, (int)strcspn(name, " "), name, (int)strnlen(vers, 0x40), vers);
+            }
+            break;
+    }
+}
+
+static void job_run(size_t idx, void *a)
+{
+    job_arg_t *arg = a;
+    job_t *job = &arg->job[idx];
+    job_hdr(job);
+    // Don't warn from here, the output would interleave. job_do() prints the ctx instead.
+    uint64_t t = trace_begin();
+    job->ret = recfg_check_ctx(job->mem, job->size, NULL, &job->ctx);
+    trace_end("recfg_check", t, job->mem - arg->base);
+    if(job->ret != kRecfgSuccess)
+    {
+        return;
+    }
+    job->checked = true;
+    t = trace_begin();
+    job->ret = recfg_walk_ctx(job->mem, job->size, &recfg_print_cb, arg->filter, &job->out, &job->ctx);
+    trace_end("recfg_walk", t, job->mem - arg->base);
+    if(job->ret == kRecfgSuccess && job->sep)
+    {
+        buf_printf(&job->out, "\n");
+    }
+}
+
+// Checks and walks sequences in parallel, but prints them in order and stops at the first failure,
+// exactly as if they had been done one after another.
+static int job_do(job_list_t *list, char *base, const recfg_filter_t *filter)
+{
+    for(size_t i = 0; i < list->num; i += JOB_BATCH)
+    {
+        size_t n = list->num - i < JOB_BATCH ? list->num - i : JOB_BATCH;
+        job_arg_t arg =
+        {
+            .job    = &list->job[i],
+            .base   = base,
+            .filter = filter,
+        };
+        parallel_for(n, &job_run, &arg);
+        for(size_t j = i; j < i + n; ++j)
+        {
+            job_t *job = &list->job[j];
+            if(job->out.oom)
+            {
+                ERR("Out of memory (sequence 0x%lx)", job->mem - base);
+                return -1;
+            }
+            uint64_t t = trace_begin();
+            fwrite(job->out.buf, 1, job->out.len, stdout);
+            trace_end("output", t, job->mem - base);
+            buf_free(&job->out);
+            if(job->ret != kRecfgSuccess && job->ctx.err != kRecfgErrCallback)
+            {
+                ERR("!(%s)", job->ctx.reason);
+            }
+            if(!job->checked)
+            {
+                ERR("Error at offset 0x%lx (sequence 0x%lx)", job->mem - base + job->ctx.off, job->mem - base);
+                return -1;
+            }
+            if(job->ret != kRecfgSuccess)
+            {
+                return job->ret;
+            }
+        }
+    }
+    return 0;
+}
+
+// Like job_do(), but records everything into `pack` rather than printing it.
+// Headers are kept as the text job_do() would have printed, so unpack() can reproduce its output.
+static int job_pack(job_list_t *list, char *base, size_t off, const recfg_filter_t *filter, pack_t *pack)
+{
+    uint64_t t = trace_begin();
+    for(size_t i = 0; i < list->num; ++i)
+    {
+        job_t *job = &list->job[i];
+        if(job->size != 0)
+        {
+            size_t err = 0;
+            if(recfg_check(job->mem, job->size, &err, true) != kRecfgSuccess)
+            {
+                ERR("Error at offset 0x%lx (sequence 0x%lx)", job->mem - base + err, job->mem - base);
+                return -1;
+            }
+        }
+        job_hdr(job);
+        if(job->out.oom)
+        {
+            ERR("Out of memory");
+            return -1;
+        }
+        pack_seq(pack, job->mem - base + off, job->size, job->out.buf, job->out.len, job->sep);
+        buf_free(&job->out);
+        if(job->size == 0)
+        {
+            continue;
+        }
+        int r = recfg_walk_filter(job->mem, job->size, &pack_cb, filter, pack);
+        if(r != kRecfgSuccess)
+        {
+            return r;
+        }
+    }
+    trace_end("pack", t, off);
+    if(pack->oom)
+    {
+        ERR("Out of memory");
+        return -1;
+    }
+    return 0;
+}
+
+// Prints a packed sequence the same way as a freshly walked one.
+int recfg_dump_seq(const pack_view_t *view, uint64_t idx, const recfg_filter_t *filter, buf_t *out)
+{
+    const pack_seq_t *seq = &view->seq[idx];
+    buf_printf(out, "%.*s", (int)seq->hdr_len, view->str + seq->hdr_off);
+    uint64_t t = trace_begin();
+    int r = pack_walk(view, idx, &recfg_print_cb, filter, out);
+    trace_end("pack_walk", t, seq->src_off);
+    if(r == kRecfgSuccess && seq->sep)
+    {
+        buf_printf(out, "\n");
+    }
+    return r;
+}
+
+static int unpack(void *mem, size_t size, void *a)
+{
+    recfg_arg_t *arg = a;
+    pack_view_t view;
+    // Stands in for recfg_check(), the sequences were checked when they were packed
+    uint64_t t = trace_begin();
+    int r = pack_view(mem, size, &view);
+    trace_end("pack_view", t, TRACE_NOARG);
+    if(r != 0)
+    {
+        ERR("Not a valid pack file");
         return -1;
     }
-    recfg_cb_t cb =
+    buf_t out = {};
+    int retval = 0;
+    for(uint64_t i = 0; i < view.nseq; ++i)
+    {
+        out.len = 0;
+        retval = recfg_dump_seq(&view, i, arg->filter, &out);
+        if(out.oom)
+        {
+            ERR("Out of memory");
+            retval = -1;
+            break;
+        }
+        fwrite(out.buf, 1, out.len, stdout);
+        if(retval != kRecfgSuccess)
+        {
+            break;
+        }
+    }
+    buf_free(&out);
+    return retval;
+}
+
+typedef struct
+{
+    size_t off;
+    size_t len;
+} carve_seq_t;
+
+typedef struct
+{
+    carve_seq_t *seq;
+    size_t num;
+    size_t cap;
+    size_t reached; // Where the worker stopped scanning
+} carve_list_t;
+
+typedef struct
+{
+    char *mem;
+    size_t size;
+    carve_list_t *chunks;
+} carve_arg_t;
+
+static bool carve_push(carve_list_t *list, size_t off, size_t len)
+{
+    if(list->num >= list->cap)
+    {
+        size_t cap = list->cap ? list->cap * 2 : 0x10;
+        carve_seq_t *seq = realloc(list->seq, cap * sizeof(*seq));
+        if(!seq)
+        {
+            return false;
+        }
+        list->seq = seq;
+        list->cap = cap;
+    }
+    list->seq[list->num++] = (carve_seq_t){ .off = off, .len = len };
+    return true;
+}
+
+// Plausibility check on a single header, without looking past it.
+// Only delay is accepted for meta, since we don't want to report empty sequences.
+static bool carve_hdr(uint32_t hdr)
+{
+    switch(hdr & 0x3)
+    {
+        case kRecfgMeta:
+            return ((hdr >> 2) & 0xf) == kRecfgDelay;
+        case kRecfgRead:
+            return ((hdr >> 2) & 0x7) == 0;
+        default:
+            return true;
+    }
+}
+
+// Where following commands from some offset leads, relative to the start of the memo window.
+typedef struct
+{
+    uint32_t end;   // Offset right after kRecfgEnd, 0 if not known yet, CARVE_FAIL if it never gets there
+    uint32_t num;   // Commands before kRecfgEnd, saturated at 2
+} carve_memo_t;
+
+// Memo over the words in [lo, hi), so that a run of commands is only followed once,
+// no matter from how many offsets inside of it we start.
+typedef struct
+{
+    carve_memo_t *memo;
+    size_t lo;
+    size_t hi;
+} carve_win_t;
+
+static carve_memo_t* carve_memo(carve_win_t *win, size_t pos)
+{
+    return win && pos >= win->lo && pos < win->hi ? &win->memo[(pos - win->lo) / sizeof(uint32_t)] : NULL;
+}
+
+// Returns the length of a valid sequence of at least two commands plus kRecfgEnd at `off`, or 0.
+// `win` may be NULL, in which case nothing is remembered.
+static size_t carve_at(char *mem, size_t size, size_t off, carve_win_t *win)
+{
+    size_t avail = size - off;
+    if(avail < 3 * sizeof(uint32_t) || !carve_hdr(*(const uint32_t*)(mem + off)))
+    {
+        return 0;
+    }
+    // Follow the commands until we hit kRecfgEnd, something invalid, or something already known
+    // With a memo, runs are followed to the end of the window, so that what we record holds for every
+    // start inside the chunk. Leaving the window means a run is too long for any of them.
+    size_t lim = win ? win->hi : off + CARVE_MAX,
+           top = lim < size ? lim : size,
+           pos = off,
+           steps = 0,
+           end = 0,
+           num = 0;
+    while(true)
+    {
+        if(pos >= top)
+        {
+            break;
+        }
+        carve_memo_t *m = carve_memo(win, pos);
+        if(m && m->end)
+        {
+            if(m->end != CARVE_FAIL)
+            {
+                end = win->lo + m->end;
+                num = m->num;
+            }
+            break;
+        }
+        size_t len = recfg_cmd_size(mem + pos, size - pos);
+        if(len == 0)
+        {
+            break;
+        }
+        recfg_cmd_t *cmd = (recfg_cmd_t*)(mem + pos);
+        if(RECFG_CMD_CMD_r(cmd) == kRecfgMeta && RECFG_CMD_META_r(cmd) == kRecfgEnd)
+        {
+            end = pos + len;
+            break;
+        }
+        pos += len;
+        ++steps;
+    }
+    // Same walk again, recording the outcome for every command on the way
+    if(win)
+    {
+        for(size_t i = 0, p = off; i <= steps; ++i)
+        {
+            carve_memo_t *m = carve_memo(win, p);
+            if(!m || m->end)
+            {
+                break;
+            }
+            m->end = end ? end - win->lo : CARVE_FAIL;
+            m->num = num + steps - i < 2 ? num + steps - i : 2;
+            p += recfg_cmd_size(mem + p, size - p);
+        }
+    }
+    if(end == 0 || num + steps < 2 || end - off > CARVE_MAX)
+    {
+        return 0;
+    }
+    return end - off;
+}
+
+static void carve_chunk(size_t idx, void *a)
+{
+    carve_arg_t *arg = a;
+    carve_list_t *list = &arg->chunks[idx];
+    size_t off = idx * CARVE_CHUNK,
+           top = off + CARVE_CHUNK < arg->size ? off + CARVE_CHUNK : arg->size;
+    uint64_t t = trace_begin();
+    carve_win_t win =
+    {
+        .memo = calloc((CARVE_CHUNK + CARVE_MAX) / sizeof(uint32_t), sizeof(carve_memo_t)),
+        .lo   = off,
+        .hi   = off + CARVE_CHUNK + CARVE_MAX,
+    };
+    while(off < top)
+    {
+        // Without the memo this is still correct, just slow on long runs
+        size_t len = carve_at(arg->mem, arg->size, off, win.memo ? &win : NULL);
+        if(len == 0)
+        {
+            off += sizeof(uint32_t);
+            continue;
+        }
+        if(!carve_push(list, off, len))
+        {
+            // Out of memory, leave the rest to the merge step
+            break;
+        }
+        off += len;
+    }
+    list->reached = off;
+    if(win.memo) free(win.memo);
+    trace_end("carve_chunk", t, idx * CARVE_CHUNK);
+}
+
+// Finds maximal, non-overlapping sequences at any 4-byte aligned offset.
+// Chunks are scanned in parallel as if a sequence started at each chunk's start, and then stitched
+// back together. Where a sequence spills into the next chunk, that chunk is rescanned sequentially
+// until it reaches an offset that its worker also considered, since from there on the results agree.
+static int carve(char *mem, size_t size, char *base, job_list_t *jobs)
+{
+    const bool warn = true; // for macros
+    int retval = -1;
+    size_t nchunks = (size + CARVE_CHUNK - 1) / CARVE_CHUNK;
+    carve_list_t *chunks = NULL,
+                  found  = {};
+    if(nchunks > 0)
+    {
+        chunks = calloc(nchunks, sizeof(*chunks));
+        REQ(chunks);
+    }
+
+    uint64_t t = trace_begin();
+    carve_arg_t arg =
+    {
+        .mem    = mem,
+        .size   = size,
+        .chunks = chunks,
+    };
+    parallel_for(nchunks, &carve_chunk, &arg);
+
+    size_t pos = 0;
+    for(size_t i = 0; i < nchunks; ++i)
+    {
+        carve_list_t *list = &chunks[i];
+        size_t top = (i + 1) * CARVE_CHUNK < size ? (i + 1) * CARVE_CHUNK : size,
+               idx = 0;
+        while(pos < top)
+        {
+            while(idx < list->num && list->seq[idx].off + list->seq[idx].len <= pos) ++idx;
+            if(pos < list->reached && !(idx < list->num && list->seq[idx].off < pos))
+            {
+                // Worker got here too, so its results from here on are what we'd find
+                for(; idx < list->num; ++idx)
+                {
+                    REQ(carve_push(&found, list->seq[idx].off, list->seq[idx].len));
+                }
+                pos = list->reached;
+                continue;
+            }
+            size_t len = carve_at(mem, size, pos, NULL);
+            if(len == 0)
+            {
+                pos += sizeof(uint32_t);
+                continue;
+            }
+            REQ(carve_push(&found, pos, len));
+            pos += len;
+        }
+    }
+    trace_end("carve", t, mem - base);
+
+    for(size_t i = 0; i < found.num; ++i)
+    {
+        job_t *job = job_push(jobs, mem + found.seq[i].off, found.seq[i].len, true);
+        REQ(job);
+        // Same units as search(), just with a file offset rather than an address
+        job->hdr   = kJobHdrSeq;
+        job->hdr_a = mem - base + found.seq[i].off;
+        job->hdr_b = found.seq[i].len / sizeof(uint32_t);
+    }
+    retval = 0;
+
+out:;
+    if(chunks)
+    {
+        for(size_t i = 0; i < nchunks; ++i)
+        {
+            if(chunks[i].seq) free(chunks[i].seq);
+        }
+        free(chunks);
+    }
+    if(found.seq) free(found.seq);
+    return retval;
+}
+
+// Finds the {ptr, count} table in an iBoot image at `ptr` and adds a job for each sequence in it.
+static int search(char *ptr, size_t len, job_list_t *jobs, const bool warn)
+{
+    int retval = -1;
+    uint64_t t = trace_begin();
+    REQ(len >= 0x320);
+    REQ(strncmp(ptr + 0x280, "iBoot-", 6) == 0);
+    uint64_t base = *(uint64_t*)(ptr + (*(uint32_t*)(ptr + 0x8) == 0x580017c1 /* ldr x1, 0x300 */ ? 0x300 : 0x318)),
+             top  = base + len;
+    for(uint64_t *cur = (uint64_t*)(ptr + 0x320), *end = cur + ((len-0x320)/sizeof(*cur)); cur < end; ++cur)
+    {
+        uint64_t a = cur[ 0],
+                 b = cur[-1],
+                 c = cur[-2],
+                 d = cur[-3];
+        if
+        (
+            a == 0 && b == 0 &&
+            (c & 0x1) == 0 && c > 0 && c < 0x10000 && // Completely baseless assumption that sequence parts are never longer
+            (d & 0x3) == 0 && d > base && d + c * sizeof(uint32_t) < top
+        )
+        {
+            uint64_t *p = cur - 3;
+            while(true)
+            {
+                c = p[-1];
+                d = p[-2];
+                if
+                (
+                    (c & 0x1) == 0 && c > 0 && c < 0x10000 &&
+                    (d & 0x3) == 0 && d > base && d + c * sizeof(uint32_t) < top
+                )
+                {
+                    p -= 2;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            for(; p[0] != 0 && p[1] != 0; p += 2)
+            {
+                job_t *job = job_push(jobs, ptr + p[0] - base, p[1] * sizeof(uint32_t), true);
+                REQ(job);
+                job->hdr   = kJobHdrSeq;
+                job->hdr_a = p[0];
+                job->hdr_b = p[1];
+            }
+        }
+    }
+    retval = 0;
+
+out:;
+    trace_end("search", t, TRACE_NOARG);
+    return retval;
+}
+
+// Patterns expected at offset 0x200 of an image. The version at 0x280 is always "iBoot-".
+static const char *const scan_pat[] =
+{
+    "iBoot for ",
+    "iBSS for ",
+    "iBEC for ",
+    "LLB for ",
+};
+
+#define SCAN_PATS   (sizeof(scan_pat)/sizeof(scan_pat[0]))
+#define SCAN_MIN    8   // Length of the shortest pattern
+
+typedef struct
+{
+    uint8_t shift[0x100];   // Set-Horspool shift, keyed on the last byte of the window
+    uint8_t last[0x100];    // Bitmask of patterns whose SCAN_MIN'th byte is this
+} scan_tab_t;
+
+typedef struct
+{
+    char *mem;
+    size_t size;
+    const scan_tab_t *tab;
+    carve_list_t *chunks;   // Reused for hits, `len` is unused
+} scan_arg_t;
+
+typedef struct
+{
+    char *mem;
+    char *base;
+    size_t *img;
+    size_t nimg;
+    size_t size;
+    job_list_t *jobs;
+} scan_img_arg_t;
+
+static void scan_tab_init(scan_tab_t *tab)
+{
+    memset(tab, 0, sizeof(*tab));
+    memset(tab->shift, SCAN_MIN, sizeof(tab->shift));
+    for(size_t i = 0; i < SCAN_PATS; ++i)
+    {
+        const uint8_t *pat = (const uint8_t*)scan_pat[i];
+        for(size_t j = 0; j < SCAN_MIN - 1; ++j)
+        {
+            if(tab->shift[pat[j]] > SCAN_MIN - 1 - j) tab->shift[pat[j]] = SCAN_MIN - 1 - j;
+        }
+        tab->last[pat[SCAN_MIN - 1]] |= 1 << i;
+    }
+}
+
+static void scan_chunk(size_t idx, void *a)
+{
+    scan_arg_t *arg = a;
+    carve_list_t *list = &arg->chunks[idx];
+    size_t pos = idx * CARVE_CHUNK,
+           top = pos + CARVE_CHUNK < arg->size ? pos + CARVE_CHUNK : arg->size;
+    const uint8_t *mem = (const uint8_t*)arg->mem;
+    uint64_t t = trace_begin();
+    // Windows start in [pos, top), but may extend into the next chunk.
+    while(pos < top && arg->size - pos >= SCAN_MIN)
+    {
+        uint8_t c = mem[pos + SCAN_MIN - 1];
+        uint8_t m = arg->tab->last[c];
+        for(size_t i = 0; m; ++i, m >>= 1)
+        {
+            size_t len = strlen(scan_pat[i]);
+            if((m & 1) && arg->size - pos >= len && memcmp(mem + pos, scan_pat[i], len) == 0)
+            {
+                if(!carve_push(list, pos, 0))
+                {
+                    goto out;
+                }
+                break;
+            }
+        }
+        pos += arg->tab->shift[c];
+    }
+out:;
+    list->reached = pos;
+    trace_end("scan_chunk", t, idx * CARVE_CHUNK);
+}
+
+static void scan_img(size_t idx, void *a)
+{
+    scan_img_arg_t *arg = a;
+    size_t off = arg->img[idx],
+           len = (idx + 1 < arg->nimg ? arg->img[idx + 1] : arg->size) - off;
+    job_list_t *jobs = &arg->jobs[idx];
+    // Header-only job
+    job_t *job = job_push(jobs, arg->mem + off, 0, false);
+    if(!job)
+    {
+        return;
+    }
+    job->hdr   = kJobHdrImage;
+    job->hdr_a = arg->mem + off - arg->base;
+    if(search(arg->mem + off, len, jobs, false) != 0 || jobs->num == 1)
+    {
+        job_free(jobs);
+    }
+}
+
+// Finds every iBoot-style image in a large file, then searches each for sequence tables.
+static int scan(char *mem, size_t size, char *base, job_list_t *jobs)
+{
+    const bool warn = true; // for macros
+    int retval = -1;
+    size_t nchunks = (size + CARVE_CHUNK - 1) / CARVE_CHUNK,
+           nimg = 0;
+    carve_list_t *chunks = NULL;
+    size_t *img = NULL;
+    job_list_t *imgjobs = NULL;
+    scan_tab_t tab;
+    scan_tab_init(&tab);
+    if(nchunks > 0)
+    {
+        chunks = calloc(nchunks, sizeof(*chunks));
+        REQ(chunks);
+    }
+
+    uint64_t t = trace_begin();
+    scan_arg_t arg =
     {
-        .generic = NULL,
-        .end     = recfg_end_cb,
-        .delay   = recfg_delay_cb,
-        .r32     = recfg_read32_cb,
-        .r64     = recfg_read64_cb,
-        .w32     = recfg_write32_cb,
-        .w64     = recfg_write64_cb,
+        .mem    = mem,
+        .size   = size,
+        .tab    = &tab,
+        .chunks = chunks,
     };
-    return recfg_walk(mem, size, &cb, NULL);
+    parallel_for(nchunks, &scan_chunk, &arg);
+    size_t nhits = 0;
+    for(size_t i = 0; i < nchunks; ++i)
+    {
+        REQ(chunks[i].reached >= (i + 1) * CARVE_CHUNK || chunks[i].reached + SCAN_MIN > size); // Else we ran out of memory
+        nhits += chunks[i].num;
+    }
+    if(nhits > 0)
+    {
+        img = malloc(nhits * sizeof(*img));
+        REQ(img);
+    }
+    for(size_t i = 0; i < nchunks; ++i)
+    {
+        for(size_t j = 0; j < chunks[i].num; ++j)
+        {
+            size_t off = chunks[i].seq[j].off;
+            if(off < 0x200)
+            {
+                continue;
+            }
+            off -= 0x200;
+            if(size - off >= 0x320 && strncmp(mem + off + 0x280, "iBoot-", 6) == 0)
+            {
+                img[nimg++] = off;
+            }
+        }
+    }
+    trace_end("scan", t, TRACE_NOARG);
+
+    if(nimg > 0)
+    {
+        imgjobs = calloc(nimg, sizeof(*imgjobs));
+        REQ(imgjobs);
+    }
+    scan_img_arg_t imgarg =
+    {
+        .mem  = mem,
+        .base = base,
+        .img  = img,
+        .nimg = nimg,
+        .size = size,
+        .jobs = imgjobs,
+    };
+    parallel_for(nimg, &scan_img, &imgarg);
+    for(size_t i = 0; i < nimg; ++i)
+    {
+        for(size_t j = 0; j < imgjobs[i].num; ++j)
+        {
+            job_t *job = job_push(jobs, NULL, 0, false);
+            REQ(job);
+            *job = imgjobs[i].job[j];
+        }
+        // Buffers now belong to `jobs`
+        if(imgjobs[i].job) free(imgjobs[i].job);
+        imgjobs[i] = (job_list_t){};
+    }
+    retval = 0;
+
+out:;
+    if(imgjobs)
+    {
+        for(size_t i = 0; i < nimg; ++i)
+        {
+            job_free(&imgjobs[i]);
+        }
+        free(imgjobs);
+    }
+    if(img) free(img);
+    if(chunks)
+    {
+        for(size_t i = 0; i < nchunks; ++i)
+        {
+            if(chunks[i].seq) free(chunks[i].seq);
+        }
+        free(chunks);
+    }
+    return retval;
+}
+
+typedef struct
+{
+    uint64_t *blk;
+    size_t num;
+    size_t cap;
+} hazard_set_t;
+
+typedef struct
+{
+    char *mem;
+    size_t size;
+    size_t off;         // Relative to the start of the search
+    uint64_t id;        // Address or file offset, as in the sequence's "#" header
+    uint64_t words;
+    hazard_set_t rd;
+    hazard_set_t wr;
+    bool oom;
+    int ret;
+    recfg_ctx_t ctx;
+    buf_t out;
+} hazard_seq_t;
+
+typedef struct
+{
+    hazard_seq_t *seq;
+    size_t num;
+    const recfg_filter_t *filter;
+} hazard_arg_t;
+
+static void hazard_push(hazard_seq_t *seq, hazard_set_t *set, uint64_t blk)
+{
+    // Consecutive commands mostly hit the same block, so this keeps the sets small before sorting
+    if(set->num > 0 && set->blk[set->num - 1] == blk)
+    {
+        return;
+    }
+    if(set->num >= set->cap)
+    {
+        size_t cap = set->cap ? set->cap * 2 : 0x40;
+        uint64_t *b = realloc(set->blk, cap * sizeof(*b));
+        if(!b)
+        {
+            seq->oom = true;
+            return;
+        }
+        set->blk = b;
+        set->cap = cap;
+    }
+    set->blk[set->num++] = blk;
+}
+
+// Uses the header alone, with the same block numbers as recfg_filter_cmd().
+static int hazard_cmd_cb(void *a, const recfg_cmd_t *cmd)
+{
+    hazard_seq_t *seq = a;
+    switch(RECFG_CMD_CMD_r(cmd))
+    {
+        case kRecfgRead:
+            hazard_push(seq, &seq->rd, RECFG_CMD_DATA_r(cmd));
+            break;
+        case kRecfgWrite32:
+        case kRecfgWrite64:
+            hazard_push(seq, &seq->wr, RECFG_CMD_DATA_r(cmd));
+            break;
+    }
+    return seq->oom ? kRecfgFailure : kRecfgSuccess;
+}
+
+static int hazard_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a,
+             y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void hazard_sort(hazard_set_t *set)
+{
+    qsort(set->blk, set->num, sizeof(*set->blk), &hazard_cmp);
+    size_t n = 0;
+    for(size_t i = 0; i < set->num; ++i)
+    {
+        if(n == 0 || set->blk[n - 1] != set->blk[i])
+        {
+            set->blk[n++] = set->blk[i];
+        }
+    }
+    set->num = n;
+}
+
+// Size of the intersection of two sorted sets, and its lowest element in `first` if non-empty.
+static size_t hazard_isect(const hazard_set_t *x, const hazard_set_t *y, uint64_t *first)
+{
+    size_t n = 0;
+    for(size_t i = 0, j = 0; i < x->num && j < y->num; )
+    {
+        if     (x->blk[i] < y->blk[j]) ++i;
+        else if(x->blk[i] > y->blk[j]) ++j;
+        else
+        {
+            if(n++ == 0 && *first > x->blk[i]) *first = x->blk[i];
+            ++i;
+            ++j;
+        }
+    }
+    return n;
+}
+
+static void hazard_collect(size_t idx, void *a)
+{
+    hazard_arg_t *arg = a;
+    hazard_seq_t *seq = &arg->seq[idx];
+    uint64_t t = trace_begin();
+    seq->ret = recfg_check_ctx(seq->mem, seq->size, NULL, &seq->ctx);
+    if(seq->ret == kRecfgSuccess)
+    {
+        static const recfg_cb_t cb = { .generic = &hazard_cmd_cb };
+        seq->ret = recfg_walk_ctx(seq->mem, seq->size, &cb, arg->filter, seq, &seq->ctx);
+        hazard_sort(&seq->rd);
+        hazard_sort(&seq->wr);
+    }
+    trace_end("hazard_collect", t, seq->off);
+}
+
+// Compares sequence `idx` against every later one. Each row is independent, so they run in parallel.
+static void hazard_row(size_t idx, void *a)
+{
+    hazard_arg_t *arg = a;
+    hazard_seq_t *x = &arg->seq[idx];
+    uint64_t t = trace_begin();
+    for(size_t j = idx + 1; j < arg->num; ++j)
+    {
+        hazard_seq_t *y = &arg->seq[j];
+        uint64_t first = ~0ULL;
+        size_t raw = hazard_isect(&x->wr, &y->rd, &first),
+               war = hazard_isect(&x->rd, &y->wr, &first),
+               waw = hazard_isect(&x->wr, &y->wr, &first);
+        if(raw || war || waw)
+        {
+            buf_printf(&x->out, "0x%llx 0x%llx RAW %lu WAR %lu WAW %lu first 0x%llx\n", x->id, y->id, raw, war, waw, first << 10);
+        }
+    }
+    trace_end("hazard_row", t, x->off);
+}
+
+// Summarizes the 1KB blocks each sequence reads and writes, then reports every pair of sequences
+// whose accesses conflict. Pairs that aren't listed touch disjoint hardware.
+// Sequences are named the way job_do() would head them, `off` is where `base` is in the file.
+static int hazard(job_list_t *jobs, char *base, size_t off, const recfg_filter_t *filter)
+{
+    const bool warn = true; // for macros
+    int retval = -1;
+    hazard_seq_t *seq = NULL;
+    size_t num = 0;
+    if(jobs->num > 0)
+    {
+        seq = calloc(jobs->num, sizeof(*seq));
+        REQ(seq);
+    }
+    for(size_t i = 0; i < jobs->num; ++i)
+    {
+        if(jobs->job[i].size == 0)
+        {
+            continue;
+        }
+        seq[num].mem  = jobs->job[i].mem;
+        seq[num].size = jobs->job[i].size;
+        seq[num].off  = jobs->job[i].mem - base;
+        if(jobs->job[i].hdr == kJobHdrSeq)
+        {
+            seq[num].id    = jobs->job[i].hdr_a;
+            seq[num].words = jobs->job[i].hdr_b;
+        }
+        else
+        {
+            seq[num].id    = off + seq[num].off;
+            seq[num].words = seq[num].size / sizeof(uint32_t);
+        }
+        ++num;
+    }
+    hazard_arg_t arg =
+    {
+        .seq    = seq,
+        .num    = num,
+        .filter = filter,
+    };
+    parallel_for(num, &hazard_collect, &arg);
+    for(size_t i = 0; i < num; ++i)
+    {
+        if(seq[i].oom)
+        {
+            ERR("Out of memory (sequence 0x%lx)", seq[i].off);
+            goto out;
+        }
+        if(seq[i].ret != kRecfgSuccess)
+        {
+            ERR("!(%s)", seq[i].ctx.reason);
+            ERR("Error at offset 0x%lx (sequence 0x%lx)", seq[i].off + seq[i].ctx.off, seq[i].off);
+            goto out;
+        }
+        LOG("# 0x%llx 0x%llx rd %lu wr %lu", seq[i].id, seq[i].words, seq[i].rd.num, seq[i].wr.num);
+    }
+    parallel_for(num, &hazard_row, &arg);
+    size_t pairs = num * (num - (num > 0)) / 2,
+           conflicts = 0;
+    for(size_t i = 0; i < num; ++i)
+    {
+        if(seq[i].out.oom)
+        {
+            ERR("Out of memory (sequence 0x%lx)", seq[i].off);
+            goto out;
+        }
+        fwrite(seq[i].out.buf, 1, seq[i].out.len, stdout);
+        for(size_t k = 0; k < seq[i].out.len; ++k)
+        {
+            if(seq[i].out.buf[k] == '\n') ++conflicts;
+        }
+    }
+    LOG("independent %lu of %lu pairs", pairs - conflicts, pairs);
+    retval = 0;
+
+out:;
+    if(seq)
+    {
+        for(size_t i = 0; i < num; ++i)
+        {
+            if(seq[i].rd.blk) free(seq[i].rd.blk);
+            if(seq[i].wr.blk) free(seq[i].wr.blk);
+            buf_free(&seq[i].out);
+        }
+        free(seq);
+    }
+    return retval;
 }
 
 int recfg(void *mem, size_t size, void *a)
@@ -94,6 +1104,7 @@ int recfg(void *mem, size_t size, void *a)
     const bool warn = true; // for macros
     int retval = kRecfgFailure;
     recfg_arg_t *arg = a;
+    job_list_t jobs = {};
 
     REQ(arg->off <= size);
     REQ(arg->len <= arg->off + size);
@@ -102,63 +1113,103 @@ int recfg(void *mem, size_t size, void *a)
     size_t len = arg->len ? arg->len : size - arg->off;
     if(arg->flags & kFlagSearch)
     {
-        REQ(len >= 0x320);
-        REQ(strncmp(ptr + 0x280, "iBoot-", 6) == 0);
-        uint64_t base = *(uint64_t*)(ptr + (*(uint32_t*)(ptr + 0x8) == 0x580017c1 /* ldr x1, 0x300 */ ? 0x300 : 0x318)),
-                 top  = base + len;
-        for(uint64_t *cur = (uint64_t*)(ptr + 0x320), *end = cur + ((len-0x320)/sizeof(*cur)); cur < end; ++cur)
-        {
-            uint64_t a = cur[ 0],
-                     b = cur[-1],
-                     c = cur[-2],
-                     d = cur[-3];
-            if
-            (
-                a == 0 && b == 0 &&
-                (c & 0x1) == 0 && c > 0 && c < 0x10000 && // Completely baseless assumption that sequence parts are never longer
-                (d & 0x3) == 0 && d > base && d + c * sizeof(uint32_t) < top
-            )
-            {
-                uint64_t *p = cur - 3;
-                while(true)
-                {
-                    c = p[-1];
-                    d = p[-2];
-                    if
-                    (
-                        (c & 0x1) == 0 && c > 0 && c < 0x10000 &&
-                        (d & 0x3) == 0 && d > base && d + c * sizeof(uint32_t) < top
-                    )
-                    {
-                        p -= 2;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                for(; p[0] != 0 && p[1] != 0; p += 2)
-                {
-                    LOG("# 0x%llx 0x%llx", p[0], p[1]);
-                    retval = recfg_do_range(ptr + p[0] - base, p[1] * sizeof(uint32_t), ptr);
-                    if(retval != 0)
-                    {
-                        goto out;
-                    }
-                    LOG("");
-                }
-            }
+        if(search(ptr, len, &jobs, warn) != 0 || jobs.num == 0)
+        {
+            goto out;
         }
     }
+    else if(arg->flags & kFlagScan)
+    {
+        REQ(scan(ptr, len, (char*)mem, &jobs) == 0);
+    }
+    else if(arg->flags & kFlagCarve)
+    {
+        // Headers give file offsets, so they hold whatever start offset was given
+        REQ(carve(ptr, len, (char*)mem, &jobs) == 0);
+    }
     else
     {
-        retval = recfg_do_range(ptr, len, ptr);
+        REQ(job_push(&jobs, ptr, len, false));
+    }
+    if(arg->pack)
+    {
+        retval = job_pack(&jobs, ptr, arg->off, arg->filter, arg->pack);
+    }
+    else if(arg->hazard)
+    {
+        retval = hazard(&jobs, ptr, arg->off, arg->filter);
+    }
+    else
+    {
+        retval = job_do(&jobs, ptr, arg->filter);
     }
 
 out:;
+    job_free(&jobs);
     return retval;
 }
 
+bool parse_ops(const char *str, uint32_t *ops)
+{
+    static const struct
+    {
+        const char *name;
+        uint32_t op;
+    } names[] =
+    {
+        { "end",   kRecfgOpEnd     },
+        { "delay", kRecfgOpDelay   },
+        { "rd32",  kRecfgOpRead32  },
+        { "rd64",  kRecfgOpRead64  },
+        { "wr32",  kRecfgOpWrite32 },
+        { "wr64",  kRecfgOpWrite64 },
+    };
+    *ops = 0;
+    while(*str != '\0')
+    {
+        size_t len = strcspn(str, ",");
+        size_t i = 0;
+        for(; i < sizeof(names)/sizeof(names[0]); ++i)
+        {
+            if(strlen(names[i].name) == len && strncmp(names[i].name, str, len) == 0)
+            {
+                break;
+            }
+        }
+        if(i >= sizeof(names)/sizeof(names[0]))
+        {
+            return false;
+        }
+        *ops |= names[i].op;
+        str += len;
+        if(*str == ',') ++str;
+    }
+    return *ops != 0;
+}
+
+// Accepts "start-end" (exclusive) or "start+size".
+bool parse_range(const char *str, recfg_range_t *range)
+{
+    char *end = NULL;
+    range->start = strtoull(str, &end, 0);
+    if(end == str || (end[0] != '-' && end[0] != '+'))
+    {
+        return false;
+    }
+    bool plus = end[0] == '+';
+    str = end + 1;
+    range->end = strtoull(str, &end, 0);
+    if(end == str || end[0] != '\0')
+    {
+        return false;
+    }
+    if(plus)
+    {
+        range->end += range->start;
+    }
+    return range->start < range->end;
+}
+
 int main(int argc, const char **argv)
 {
     if(argc < 2)
@@ -166,34 +1217,136 @@ int main(int argc, const char **argv)
         goto badargs;
     }
     int aoff = 1;
+    bool packing   = strcmp(argv[1], "pack") == 0,
+         unpacking = strcmp(argv[1], "unpack") == 0,
+         serving   = strcmp(argv[1], "serve") == 0;
+    if(packing || unpacking || serving)
+    {
+        ++aoff;
+    }
     uint32_t flags = 0;
+    const char *trace = NULL,
+               *regs  = NULL;
+    recfg_range_t *ranges = NULL;
+    recfg_filter_t filter =
+    {
+        .ops     = kRecfgOpAll,
+        .nranges = 0,
+        .ranges  = NULL,
+    };
+    bool filtered = false,
+         hazards  = false;
     unsigned long long off = 0,
-                       len = 0;
+                       len = 0,
+                       maxmem = SERVE_MAXMEM;
     for(; aoff < argc; ++aoff)
     {
         if(argv[aoff][0] != '-')
         {
             break;
         }
-        for(size_t i = 1; argv[aoff][i] != '\0'; ++i)
+        const char *opt = argv[aoff];
+        for(size_t i = 1; opt[i] != '\0'; ++i)
         {
-            char c = argv[aoff][i];
+            char c = opt[i];
             switch(c)
             {
                 case 's':
                     flags |= kFlagSearch;
                     break;
+                case 'c':
+                    flags |= kFlagCarve;
+                    break;
+                case 'S':
+                    flags |= kFlagScan;
+                    break;
+                case 'H':
+                    hazards = true;
+                    break;
+                case 'a':
+                    {
+                        if(aoff + 1 >= argc)
+                        {
+                            goto badargs;
+                        }
+                        recfg_range_t *r = realloc(ranges, (filter.nranges + 1) * sizeof(*r));
+                        if(!r)
+                        {
+                            ERR("Out of memory");
+                            return -1;
+                        }
+                        ranges = r;
+                        if(!parse_range(argv[++aoff], &ranges[filter.nranges]))
+                        {
+                            ERR("Bad address range: %s", argv[aoff]);
+                            return -1;
+                        }
+                        ++filter.nranges;
+                        filter.ranges = ranges;
+                        filtered = true;
+                    }
+                    break;
+                case 'o':
+                    if(aoff + 1 >= argc)
+                    {
+                        goto badargs;
+                    }
+                    if(!parse_ops(argv[++aoff], &filter.ops))
+                    {
+                        ERR("Bad op list: %s", argv[aoff]);
+                        return -1;
+                    }
+                    filtered = true;
+                    break;
+                case 'r':
+                    if(aoff + 1 >= argc)
+                    {
+                        goto badargs;
+                    }
+                    regs = argv[++aoff];
+                    break;
+                case 't':
+                    if(aoff + 1 >= argc)
+                    {
+                        goto badargs;
+                    }
+                    trace = argv[++aoff];
+                    break;
+                case 'm':
+                    {
+                        if(!serving || aoff + 1 >= argc)
+                        {
+                            goto badargs;
+                        }
+                        char *end = NULL;
+                        maxmem = strtoull(argv[++aoff], &end, 0);
+                        if(end[0] != '\0')
+                        {
+                            ERR("Bad memory limit: %s", argv[aoff]);
+                            return -1;
+                        }
+                    }
+                    break;
                 default:
                     ERR("Unknown option: -%c", c);
                     return -1;
             }
         }
     }
-    if(aoff >= argc)
+    if(aoff >= argc || (flags & (flags - 1)) != 0) // At most one mode
     {
         goto badargs;
     }
-    const char *infile = argv[aoff++];
+    const char *infile = argv[aoff++],
+               *outfile = NULL;
+    if(packing)
+    {
+        if(aoff >= argc)
+        {
+            goto badargs;
+        }
+        outfile = argv[aoff++];
+    }
     if(aoff < argc)
     {
         char *end = NULL;
@@ -216,19 +1369,58 @@ int main(int argc, const char **argv)
         }
         ++aoff;
     }
-    if(aoff < argc)
+    if(aoff < argc || ((unpacking || serving) && (flags || off || len)) || (serving && filtered) ||
+       (hazards && (packing || unpacking || serving || (flags & kFlagScan))))
     {
         goto badargs;
     }
+    pack_t pack = {};
     recfg_arg_t arg =
     {
         .off = off,
         .len = len,
         .flags = flags,
+        .filter = filtered ? &filter : NULL,
+        .pack = packing ? &pack : NULL,
+        .hazard = hazards,
     };
-    return file2mem(infile, &recfg, &arg);
+    if(trace && trace_init(trace) != 0)
+    {
+        ERR("Failed to open trace file: %s", trace);
+        return -1;
+    }
+    regdb_t db;
+    if(regs)
+    {
+        if(regdb_load(regs, &db) != 0)
+        {
+            ERR("Failed to load register database: %s", regs);
+            return -1;
+        }
+        symdb = &db;
+    }
+    int retval = serving ? serve(infile, maxmem) : file2mem(infile, unpacking ? &unpack : &recfg, &arg);
+    if(packing)
+    {
+        if(retval == 0)
+        {
+            uint64_t tp = trace_begin();
+            retval = pack_write(&pack, outfile);
+            trace_end("pack_write", tp, TRACE_NOARG);
+        }
+        pack_free(&pack);
+    }
+    uint64_t t = trace_begin();
+    fflush(stdout);
+    trace_end("flush", t, TRACE_NOARG);
+    if(ranges) free(ranges);
+    if(symdb) regdb_free(&db);
+    return retval;
 
 badargs:;
-    ERR("Usage: %s [-s] file [off [len]]", argv[0]);
+    ERR("Usage: %s [-s|-S|-c] [-H] [-a start-end]... [-o op,...] [-r regs.txt] [-t trace.json] file [off [len]]", argv[0]);
+    ERR("       %s pack [options] file out.pack [off [len]]", argv[0]);
+    ERR("       %s unpack [-a start-end]... [-o op,...] [-r regs.txt] [-t trace.json] file.pack", argv[0]);
+    ERR("       %s serve [-m maxmem] [-r regs.txt] [-t trace.json] socket", argv[0]);
     return -1;
 }
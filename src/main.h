@@ -0,0 +1,47 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#ifndef MAIN_H
+#define MAIN_H
+
+#include <stdbool.h>
+#include <stddef.h>             // size_t
+#include <stdint.h>
+
+#include "pack.h"
+#include "recfg.h"
+#include "util.h"
+
+enum
+{
+    kFlagSearch = 0x1,
+    kFlagCarve  = 0x2,
+    kFlagScan   = 0x4,
+};
+
+typedef struct
+{
+    size_t off;
+    size_t len;
+    uint32_t flags;
+    const recfg_filter_t *filter;
+    pack_t *pack;
+    bool hazard;    // Report conflicts between sequences instead of printing them
+} recfg_arg_t;
+
+// Prints ops to the buf_t passed as opaque argument.
+extern const recfg_cb_t recfg_print_cb;
+
+int recfg(void *mem, size_t size, void *a);
+int recfg_dump_seq(const pack_view_t *view, uint64_t idx, const recfg_filter_t *filter, buf_t *out);
+bool parse_ops(const char *str, uint32_t *ops);
+bool parse_range(const char *str, recfg_range_t *range);
+
+#endif
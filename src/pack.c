@@ -0,0 +1,353 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#include <stdbool.h>
+#include <stddef.h>             // size_t
+#include <stdint.h>
+#include <stdio.h>              // FILE, fopen, fwrite, fclose
+#include <stdlib.h>             // realloc, free
+#include <string.h>             // memcmp, memcpy
+
+#include "common.h"
+#include "pack.h"
+#include "recfg.h"
+
+#define ALIGN8(x) (((x) + 7) & ~(uint64_t)7)
+
+static bool pack_grow(void **ptr, size_t cap, size_t elem)
+{
+    void *p = realloc(*ptr, cap * elem);
+    if(!p)
+    {
+        return false;
+    }
+    *ptr = p;
+    return true;
+}
+
+static void pack_op(pack_t *pack, uint8_t type, uint64_t addr, uint64_t val, uint64_t mask, bool retry, uint8_t recnt)
+{
+    if(pack->oom || pack->nseq == 0)
+    {
+        pack->oom = true;
+        return;
+    }
+    if(pack->nops >= pack->opcap)
+    {
+        size_t cap = pack->opcap ? pack->opcap * 2 : 0x100;
+        // Grow all columns before committing to the new capacity
+        if(!pack_grow((void**)&pack->op, cap, sizeof(*pack->op)) || !pack_grow((void**)&pack->addr, cap, sizeof(*pack->addr)) ||
+           !pack_grow((void**)&pack->val, cap, sizeof(*pack->val)) || !pack_grow((void**)&pack->mask, cap, sizeof(*pack->mask)))
+        {
+            pack->oom = true;
+            return;
+        }
+        pack->opcap = cap;
+    }
+    size_t i = pack->nops++;
+    pack->op[i]   = (pack_op_t){ .type = type, .retry = retry ? 1 : 0, .recnt = recnt };
+    pack->addr[i] = addr;
+    pack->val[i]  = val;
+    pack->mask[i] = mask;
+    pack->seq[pack->nseq - 1].nops++;
+}
+
+static int pack_end_cb(void *a)
+{
+    pack_op(a, kRecfgOpEnd, 0, 0, 0, false, 0);
+    return kRecfgSuccess;
+}
+
+static int pack_delay_cb(void *a, uint32_t *delay)
+{
+    pack_op(a, kRecfgOpDelay, 0, *delay, 0, false, 0);
+    return kRecfgSuccess;
+}
+
+static int pack_read32_cb(void *a, uint64_t *addr, uint32_t *mask, uint32_t *data, bool *retry, uint8_t *recnt)
+{
+    pack_op(a, kRecfgOpRead32, *addr, *data, *mask, *retry, *recnt);
+    return kRecfgSuccess;
+}
+
+static int pack_read64_cb(void *a, uint64_t *addr, uint64_t *mask, uint64_t *data, bool *retry, uint8_t *recnt)
+{
+    pack_op(a, kRecfgOpRead64, *addr, *data, *mask, *retry, *recnt);
+    return kRecfgSuccess;
+}
+
+static int pack_write32_cb(void *a, uint64_t *addr, uint32_t *data)
+{
+    pack_op(a, kRecfgOpWrite32, *addr, *data, 0, false, 0);
+    return kRecfgSuccess;
+}
+
+static int pack_write64_cb(void *a, uint64_t *addr, uint64_t *data)
+{
+    pack_op(a, kRecfgOpWrite64, *addr, *data, 0, false, 0);
+    return kRecfgSuccess;
+}
+
+const recfg_cb_t pack_cb =
+{
+    .generic = NULL,
+    .end     = pack_end_cb,
+    .delay   = pack_delay_cb,
+    .r32     = pack_read32_cb,
+    .r64     = pack_read64_cb,
+    .w32     = pack_write32_cb,
+    .w64     = pack_write64_cb,
+};
+
+void pack_seq(pack_t *pack, uint64_t src_off, uint64_t src_len, const char *hdr, size_t hdr_len, bool sep)
+{
+    if(pack->oom)
+    {
+        return;
+    }
+    if(pack->nstr + hdr_len > pack->strcap)
+    {
+        size_t cap = pack->strcap ? pack->strcap : 0x1000;
+        while(cap < pack->nstr + hdr_len) cap *= 2;
+        if(!pack_grow((void**)&pack->str, cap, sizeof(*pack->str)))
+        {
+            pack->oom = true;
+            return;
+        }
+        pack->strcap = cap;
+    }
+    if(pack->nseq >= pack->seqcap)
+    {
+        size_t cap = pack->seqcap ? pack->seqcap * 2 : 0x10;
+        if(!pack_grow((void**)&pack->seq, cap, sizeof(*pack->seq)))
+        {
+            pack->oom = true;
+            return;
+        }
+        pack->seqcap = cap;
+    }
+    if(hdr_len > 0) memcpy(pack->str + pack->nstr, hdr, hdr_len);
+    pack->seq[pack->nseq++] = (pack_seq_t)
+    {
+        .src_off  = src_off,
+        .src_len  = src_len,
+        .first_op = pack->nops,
+        .nops     = 0,
+        .hdr_off  = pack->nstr,
+        .hdr_len  = hdr_len,
+        .sep      = sep ? 1 : 0,
+    };
+    pack->nstr += hdr_len;
+}
+
+void pack_free(pack_t *pack)
+{
+    if(pack->seq)  free(pack->seq);
+    if(pack->op)   free(pack->op);
+    if(pack->addr) free(pack->addr);
+    if(pack->val)  free(pack->val);
+    if(pack->mask) free(pack->mask);
+    if(pack->str)  free(pack->str);
+    *pack = (pack_t){};
+}
+
+void pack_view_mem(const pack_t *pack, pack_view_t *view)
+{
+    *view = (pack_view_t)
+    {
+        .nseq = pack->nseq,
+        .nops = pack->nops,
+        .seq  = pack->seq,
+        .op   = pack->op,
+        .addr = pack->addr,
+        .val  = pack->val,
+        .mask = pack->mask,
+        .str  = pack->str,
+        .nstr = pack->nstr,
+    };
+}
+
+static bool pack_fwrite(FILE *f, const void *data, size_t len, uint64_t *pos)
+{
+    static const char zero[8] = {};
+    if(len > 0 && fwrite(data, 1, len, f) != len)
+    {
+        return false;
+    }
+    *pos += len;
+    size_t pad = ALIGN8(*pos) - *pos;
+    if(pad > 0 && fwrite(zero, 1, pad, f) != pad)
+    {
+        return false;
+    }
+    *pos += pad;
+    return true;
+}
+
+int pack_write(const pack_t *pack, const char *path)
+{
+    const bool warn = true; // for macros
+    int retval = -1;
+    FILE *f = NULL;
+
+    REQ(!pack->oom);
+    pack_hdr_t hdr =
+    {
+        .version  = PACK_VERSION,
+        .hdr_size = sizeof(pack_hdr_t),
+        .nseq     = pack->nseq,
+        .nops     = pack->nops,
+    };
+    memcpy(hdr.magic, PACK_MAGIC, sizeof(hdr.magic));
+    hdr.seq_off  = ALIGN8(sizeof(pack_hdr_t));
+    hdr.op_off   = ALIGN8(hdr.seq_off + hdr.nseq * sizeof(pack_seq_t));
+    hdr.addr_off = ALIGN8(hdr.op_off + hdr.nops * sizeof(pack_op_t));
+    hdr.val_off  = hdr.addr_off + hdr.nops * sizeof(uint64_t);
+    hdr.mask_off = hdr.val_off  + hdr.nops * sizeof(uint64_t);
+    hdr.str_off  = hdr.mask_off + hdr.nops * sizeof(uint64_t);
+    hdr.str_size = pack->nstr;
+    hdr.size     = ALIGN8(hdr.str_off + hdr.str_size);
+
+    f = fopen(path, "wb");
+    REQ(f);
+    uint64_t pos = 0;
+    REQ(pack_fwrite(f, &hdr, sizeof(hdr), &pos));
+    REQ(pos == hdr.seq_off);
+    REQ(pack_fwrite(f, pack->seq, pack->nseq * sizeof(*pack->seq), &pos));
+    REQ(pos == hdr.op_off);
+    REQ(pack_fwrite(f, pack->op, pack->nops * sizeof(*pack->op), &pos));
+    REQ(pos == hdr.addr_off);
+    REQ(pack_fwrite(f, pack->addr, pack->nops * sizeof(*pack->addr), &pos));
+    REQ(pack_fwrite(f, pack->val, pack->nops * sizeof(*pack->val), &pos));
+    REQ(pack_fwrite(f, pack->mask, pack->nops * sizeof(*pack->mask), &pos));
+    REQ(pos == hdr.str_off);
+    REQ(pack_fwrite(f, pack->str, pack->nstr, &pos));
+    REQ(pos == hdr.size);
+    retval = 0;
+
+out:;
+    if(f && fclose(f) != 0) retval = -1;
+    return retval;
+}
+
+// Checks that `num` elements of `elem` bytes at `off` are aligned and lie within `size`.
+static bool pack_section(uint64_t off, uint64_t num, size_t elem, size_t size)
+{
+    return (off & 7) == 0 && off <= size && num <= (size - off) / elem;
+}
+
+int pack_view(const void *mem, size_t size, pack_view_t *view)
+{
+    const bool warn = true; // for macros
+    int retval = -1;
+    const char *base = mem;
+    const pack_hdr_t *hdr = mem;
+
+    REQ(size >= sizeof(pack_hdr_t));
+    REQ(memcmp(hdr->magic, PACK_MAGIC, sizeof(hdr->magic)) == 0);
+    REQ(hdr->version == PACK_VERSION);
+    REQ(hdr->hdr_size >= sizeof(pack_hdr_t) && hdr->hdr_size <= size);
+    REQ(hdr->size <= size);
+    REQ(pack_section(hdr->seq_off,  hdr->nseq, sizeof(pack_seq_t), hdr->size));
+    REQ(pack_section(hdr->op_off,   hdr->nops, sizeof(pack_op_t),  hdr->size));
+    REQ(pack_section(hdr->addr_off, hdr->nops, sizeof(uint64_t),   hdr->size));
+    REQ(pack_section(hdr->val_off,  hdr->nops, sizeof(uint64_t),   hdr->size));
+    REQ(pack_section(hdr->mask_off, hdr->nops, sizeof(uint64_t),   hdr->size));
+    REQ(pack_section(hdr->str_off,  hdr->str_size, sizeof(char),   hdr->size));
+
+    *view = (pack_view_t)
+    {
+        .nseq = hdr->nseq,
+        .nops = hdr->nops,
+        .seq  = (const pack_seq_t*)(base + hdr->seq_off),
+        .op   = (const pack_op_t*) (base + hdr->op_off),
+        .addr = (const uint64_t*)  (base + hdr->addr_off),
+        .val  = (const uint64_t*)  (base + hdr->val_off),
+        .mask = (const uint64_t*)  (base + hdr->mask_off),
+        .str  = (const char*)      (base + hdr->str_off),
+        .nstr = hdr->str_size,
+    };
+    for(uint64_t i = 0; i < view->nseq; ++i)
+    {
+        REQ(view->seq[i].first_op <= view->nops && view->seq[i].nops <= view->nops - view->seq[i].first_op);
+        REQ(view->seq[i].hdr_off <= view->nstr && view->seq[i].hdr_len <= view->nstr - view->seq[i].hdr_off);
+    }
+    retval = 0;
+
+out:;
+    return retval;
+}
+
+int pack_walk(const pack_view_t *view, uint64_t idx, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a)
+{
+    const bool warn = true; // for macros
+    int retval = kRecfgFailure;
+
+    REQ(idx < view->nseq);
+    const pack_seq_t *seq = &view->seq[idx];
+    for(uint64_t i = seq->first_op, end = seq->first_op + seq->nops; i < end; ++i)
+    {
+        uint64_t addr = view->addr[i];
+        if(filter && !recfg_filter_match(filter, view->op[i].type, addr))
+        {
+            continue;
+        }
+        uint64_t val  = view->val[i],
+                 mask = view->mask[i];
+        bool retry    = !!view->op[i].retry;
+        uint8_t recnt = view->op[i].recnt;
+        int r = kRecfgSuccess;
+        switch(view->op[i].type)
+        {
+            case kRecfgOpEnd:
+                if(cb->end) r = cb->end(a);
+                break;
+            case kRecfgOpDelay:
+                if(cb->delay)
+                {
+                    uint32_t delay = val;
+                    r = cb->delay(a, &delay);
+                }
+                break;
+            case kRecfgOpRead32:
+                if(cb->r32)
+                {
+                    uint32_t m = mask, d = val;
+                    r = cb->r32(a, &addr, &m, &d, &retry, &recnt);
+                }
+                break;
+            case kRecfgOpRead64:
+                if(cb->r64) r = cb->r64(a, &addr, &mask, &val, &retry, &recnt);
+                break;
+            case kRecfgOpWrite32:
+                if(cb->w32)
+                {
+                    uint32_t d = val;
+                    r = cb->w32(a, &addr, &d);
+                }
+                break;
+            case kRecfgOpWrite64:
+                if(cb->w64) r = cb->w64(a, &addr, &val);
+                break;
+            default:
+                REQ(false);
+        }
+        REQ(r != kRecfgUpdate);
+        if(r != kRecfgSuccess)
+        {
+            retval = r;
+            goto out;
+        }
+    }
+    retval = kRecfgSuccess;
+
+out:;
+    return retval;
+}
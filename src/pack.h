@@ -0,0 +1,122 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#ifndef PACK_H
+#define PACK_H
+
+#include <stdbool.h>
+#include <stddef.h>             // size_t
+#include <stdint.h>
+
+#include "recfg.h"
+
+/**
+ * Packed format for decoded sequences, meant to be mmap'ed and used in place.
+ *
+ * Layout, in host byte order, with every section 8-byte aligned:
+ * - pack_hdr_t
+ * - pack_seq_t[nseq]   sequence directory, each referring to a run of ops
+ * - pack_op_t[nops]    fixed-width op records
+ * - uint64_t[nops]     addresses
+ * - uint64_t[nops]     values (data for reads and writes, delay for kRecfgOpDelay)
+ * - uint64_t[nops]     masks (reads only, 0 otherwise)
+ * - char[str_size]     header lines, as printed before each sequence by the mode that found it
+ *
+ * Op types are kRecfgOp* values. Offsets are relative to the start of the file.
+ * Entries without ops are allowed, e.g. for the image lines printed by -S.
+**/
+
+#define PACK_MAGIC      "RCFGPACK"
+#define PACK_VERSION    2
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t hdr_size;
+    uint64_t nseq;
+    uint64_t nops;
+    uint64_t seq_off;
+    uint64_t op_off;
+    uint64_t addr_off;
+    uint64_t val_off;
+    uint64_t mask_off;
+    uint64_t str_off;
+    uint64_t str_size;
+    uint64_t size;
+} pack_hdr_t;
+
+typedef struct
+{
+    uint64_t src_off;   // Where the sequence was found in the source file
+    uint64_t src_len;
+    uint64_t first_op;
+    uint64_t nops;
+    uint64_t hdr_off;   // Into the string section
+    uint64_t hdr_len;
+    uint32_t sep;       // Whether a blank line follows the ops
+    uint32_t __res;
+} pack_seq_t;
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t retry;
+    uint8_t recnt;
+    uint8_t __res;
+} pack_op_t;
+
+// In-memory builder, filled by walking sequences with pack_cb.
+typedef struct
+{
+    pack_seq_t *seq;
+    size_t nseq;
+    size_t seqcap;
+    pack_op_t *op;
+    uint64_t *addr;
+    uint64_t *val;
+    uint64_t *mask;
+    size_t nops;
+    size_t opcap;
+    char *str;
+    size_t nstr;
+    size_t strcap;
+    bool oom;   // Sticky, set if any append failed
+} pack_t;
+
+// Read-only view on a packed file, or on a pack_t.
+typedef struct
+{
+    uint64_t nseq;
+    uint64_t nops;
+    const pack_seq_t *seq;
+    const pack_op_t *op;
+    const uint64_t *addr;
+    const uint64_t *val;
+    const uint64_t *mask;
+    const char *str;
+    uint64_t nstr;
+} pack_view_t;
+
+extern const recfg_cb_t pack_cb;
+
+void pack_seq(pack_t *pack, uint64_t src_off, uint64_t src_len, const char *hdr, size_t hdr_len, bool sep);
+void pack_free(pack_t *pack);
+void pack_view_mem(const pack_t *pack, pack_view_t *view);
+int pack_write(const pack_t *pack, const char *path);
+
+// Validates the header and section bounds, but doesn't copy anything.
+int pack_view(const void *mem, size_t size, pack_view_t *view);
+
+// Invokes the callbacks in `cb` for every op of sequence `idx`, just like recfg_walk_filter() would have.
+// The callbacks must not return kRecfgUpdate, and `generic` is not supported. `filter` may be NULL.
+int pack_walk(const pack_view_t *view, uint64_t idx, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a);
+
+#endif
@@ -21,7 +21,190 @@
 #   define VOLATILE
 #endif
 
-int recfg_check(void *mem, size_t size, size_t *offp, const bool warn)
+// Like REQ, but also records the failure in `ctx`, which may be NULL.
+#ifdef ERR
+#   define CHK(expr, code) \
+    do \
+    { \
+        if(!(expr)) \
+        { \
+            if(warn) ERR("!(" #expr ")"); \
+            recfg_fail(ctx, code, #expr, start, cmd); \
+            goto out; \
+        } \
+    } while(0)
+#else
+#   define CHK(expr, code) \
+    do \
+    { \
+        if(!(expr)) \
+        { \
+            recfg_fail(ctx, code, #expr, start, cmd); \
+            goto out; \
+        } \
+    } while(0)
+#endif
+
+static void recfg_fail(recfg_ctx_t *ctx, int err, const char *reason, const char *start, const void *cmd)
+{
+    if(ctx)
+    {
+        ctx->err    = err;
+        ctx->off    = (const char*)cmd - start;
+        ctx->reason = reason;
+    }
+}
+
+static void recfg_ctx_init(recfg_ctx_t *ctx)
+{
+    if(ctx)
+    {
+        ctx->err    = kRecfgErrNone;
+        ctx->off    = 0;
+        ctx->reason = NULL;
+    }
+}
+
+// Remembers that the command at `cmd`, which was `len` bytes long, has been modified.
+static void recfg_dirty(recfg_track_t *track, const char *start, const void *cmd, size_t len)
+{
+    if(!track)
+    {
+        return;
+    }
+    size_t off = (const char*)cmd - start;
+    if(track->num > 0 && track->dirty[track->num - 1].off == off)
+    {
+        return;
+    }
+    if(track->num >= track->cap)
+    {
+        track->overflow = true;
+        return;
+    }
+    track->dirty[track->num++] = (recfg_dirty_t){ .off = off, .len = len };
+}
+
+typedef struct
+{
+    uint8_t len;    // Length in bytes without padding, 0 if invalid
+    uint8_t pad;    // Offset at which a padding word may appear, 0 if none
+} recfg_len_t;
+
+// Indexed by the low 6 bits of a command, i.e. (meta/count/large << 2) | cmd.
+#define ALCNT(k)    (((k) + 4) & ~3)
+#define LEN_META(k) { (k) == kRecfgEnd || (k) == kRecfgDelay ? 4 : 0, 0 }
+#define LEN_W32(k)  { 4 + ALCNT(k) + 4 * ((k) + 1), 0 }
+#define LEN_READ(k) { (k) == 0 ? 16 : (k) == 8 ? 24 : 0, (k) == 8 ? 8 : 0 }
+#define LEN_W64(k)  { 4 + ALCNT(k) + 8 * ((k) + 1), 4 + ALCNT(k) }
+#define LEN_ROW(k)  LEN_META(k), LEN_W32(k), LEN_READ(k), LEN_W64(k)
+
+static const recfg_len_t recfg_len_tab[0x40] =
+{
+    LEN_ROW( 0), LEN_ROW( 1), LEN_ROW( 2), LEN_ROW( 3),
+    LEN_ROW( 4), LEN_ROW( 5), LEN_ROW( 6), LEN_ROW( 7),
+    LEN_ROW( 8), LEN_ROW( 9), LEN_ROW(10), LEN_ROW(11),
+    LEN_ROW(12), LEN_ROW(13), LEN_ROW(14), LEN_ROW(15),
+};
+
+#undef LEN_ROW
+#undef LEN_W64
+#undef LEN_READ
+#undef LEN_W32
+#undef LEN_META
+#undef ALCNT
+
+// Length of a command including padding, or 0 if it is invalid or longer than `avail`.
+static size_t recfg_cmd_len(recfg_cmd_t *cmd, size_t avail)
+{
+    uint32_t idx = (RECFG_CMD_META_r(cmd) << 2) | RECFG_CMD_CMD_r(cmd);
+    size_t len = recfg_len_tab[idx].len;
+    if(len == 0 || avail < len)
+    {
+        return 0;
+    }
+    if(recfg_len_tab[idx].pad)
+    {
+        VOLATILE uint32_t *tmp = (VOLATILE uint32_t*)((char*)cmd + recfg_len_tab[idx].pad);
+        if(
+#ifdef RECFG_VOLATILE
+            ((uintptr_t)tmp & 0x4) != 0
+#else
+            *tmp == 0xdeadbeef
+#endif
+        )
+        {
+            len += sizeof(uint32_t);
+            if(avail < len)
+            {
+                return 0;
+            }
+        }
+    }
+    return len;
+}
+
+static uint32_t recfg_cmd_op(recfg_cmd_t *cmd)
+{
+    recfg_read_t *read = (recfg_read_t*)cmd;
+    switch(RECFG_CMD_CMD_r(cmd))
+    {
+        case kRecfgMeta:    return RECFG_CMD_META_r(cmd) == kRecfgEnd ? kRecfgOpEnd : kRecfgOpDelay;
+        case kRecfgRead:    return RECFG_READ_LARGE_r(read) ? kRecfgOpRead64 : kRecfgOpRead32;
+        case kRecfgWrite32: return kRecfgOpWrite32;
+        default:            return kRecfgOpWrite64;
+    }
+}
+
+static bool recfg_filter_cmd(const recfg_filter_t *filter, recfg_cmd_t *cmd)
+{
+    uint32_t op = recfg_cmd_op(cmd);
+    if(!(filter->ops & op))
+    {
+        return false;
+    }
+    if(filter->nranges == 0 || (op & (kRecfgOpEnd | kRecfgOpDelay)))
+    {
+        return true;
+    }
+    // Reads and writes both keep their 1KB block number in the data bits.
+    uint64_t block = (uint64_t)RECFG_CMD_DATA_r(cmd) << 10;
+    for(size_t i = 0; i < filter->nranges; ++i)
+    {
+        if(filter->ranges[i].start < block + 0x400 && filter->ranges[i].end > block)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool recfg_filter_addr(const recfg_filter_t *filter, uint64_t addr)
+{
+    if(!filter || filter->nranges == 0)
+    {
+        return true;
+    }
+    for(size_t i = 0; i < filter->nranges; ++i)
+    {
+        if(addr >= filter->ranges[i].start && addr < filter->ranges[i].end)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool recfg_filter_match(const recfg_filter_t *filter, uint32_t op, uint64_t addr)
+{
+    if(!(filter->ops & op))
+    {
+        return false;
+    }
+    return (op & (kRecfgOpEnd | kRecfgOpDelay)) != 0 || recfg_filter_addr(filter, addr);
+}
+
+static int recfg_check_internal(void *mem, size_t size, size_t *offp, const bool warn, recfg_ctx_t *ctx)
 {
     int retval = kRecfgFailure;
     char *start = mem,
@@ -29,38 +212,38 @@ int recfg_check(void *mem, size_t size, size_t *offp, const bool warn)
     recfg_cmd_t *cmd = mem;
     while(end - (char*)cmd != 0) // != rather than > because ptrdiff is signed
     {
-        REQ(end - (char*)cmd >= sizeof(recfg_cmd_t));
+        CHK(end - (char*)cmd >= sizeof(recfg_cmd_t), kRecfgErrTruncated);
         switch(RECFG_CMD_CMD_r(cmd))
         {
             case kRecfgMeta:
                 switch(RECFG_CMD_META_r(cmd))
                 {
                     case kRecfgEnd:
-                        REQ(RECFG_CMD_DATA_r(cmd) == 0);
+                        CHK(RECFG_CMD_DATA_r(cmd) == 0, kRecfgErrField);
                         goto end;
                     case kRecfgDelay:
                         break;
                     default:
-                        REQ(false);
+                        CHK(false, kRecfgErrCommand);
                 }
                 cmd = cmd + 1;
                 break;
             case kRecfgRead:
-                REQ(end - (char*)cmd >= sizeof(recfg_read_t));
+                CHK(end - (char*)cmd >= sizeof(recfg_read_t), kRecfgErrTruncated);
                 recfg_read_t *read = (recfg_read_t*)cmd;
-                REQ(RECFG_READ_COUNT_r(read) == 0);
+                CHK(RECFG_READ_COUNT_r(read) == 0, kRecfgErrField);
                 // This can happen, and doesn't matter, I guess
                 //REQ(RECFG_READ_RETRY_r(read) || RECFG_READ_RECNT_r(read) == 0);
                 // This also happens, but I'm pretty sure Apple fucked up
                 //REQ(read->__res == 0);
                 if(!RECFG_READ_LARGE_r(read))
                 {
-                    REQ(end - (char*)cmd >= sizeof(recfg_read32_t));
+                    CHK(end - (char*)cmd >= sizeof(recfg_read32_t), kRecfgErrTruncated);
                     cmd = (recfg_cmd_t*)((recfg_read32_t*)read + 1);
                 }
                 else
                 {
-                    REQ(end - (char*)cmd >= sizeof(recfg_read64_t) + 2 * sizeof(uint64_t));
+                    CHK(end - (char*)cmd >= sizeof(recfg_read64_t) + 2 * sizeof(uint64_t), kRecfgErrTruncated);
                     recfg_read64_t *r64 = (recfg_read64_t*)read;
                     VOLATILE uint32_t *tmp = (VOLATILE uint32_t*)(r64 + 1);
                     if(
@@ -73,7 +256,7 @@ int recfg_check(void *mem, size_t size, size_t *offp, const bool warn)
 #endif
                     )
                     {
-                        REQ(end - (char*)cmd >= sizeof(recfg_read64_t) + 2 * sizeof(uint64_t) + sizeof(uint32_t));
+                        CHK(end - (char*)cmd >= sizeof(recfg_read64_t) + 2 * sizeof(uint64_t) + sizeof(uint32_t), kRecfgErrTruncated);
                         ++tmp;
                     }
                     VOLATILE uint64_t *datap = (VOLATILE uint64_t*)tmp;
@@ -83,24 +266,24 @@ int recfg_check(void *mem, size_t size, size_t *offp, const bool warn)
             case kRecfgWrite32:
                 {
                     uint32_t cnt, alcnt;
-                    REQ(end - (char*)cmd >= sizeof(recfg_write32_t));
+                    CHK(end - (char*)cmd >= sizeof(recfg_write32_t), kRecfgErrTruncated);
                     recfg_write32_t *w32 = (recfg_write32_t*)cmd;
                     cnt = RECFG_WRITE_COUNT_r(w32) + 1;
                     alcnt = (cnt + 3) & ~3;
-                    REQ(cnt <= 16 && alcnt <= 16 && (alcnt & 3) == 0); // Sanity
-                    REQ(end - (char*)cmd >= sizeof(recfg_write32_t) + alcnt * sizeof(uint8_t) + cnt * sizeof(uint32_t));
+                    CHK(cnt <= 16 && alcnt <= 16 && (alcnt & 3) == 0, kRecfgErrField); // Sanity
+                    CHK(end - (char*)cmd >= sizeof(recfg_write32_t) + alcnt * sizeof(uint8_t) + cnt * sizeof(uint32_t), kRecfgErrTruncated);
                     cmd = (recfg_cmd_t*)((VOLATILE uint32_t*)((VOLATILE uint8_t*)(w32 + 1) + alcnt) + cnt);
                 }
                 break;
             case kRecfgWrite64:
                 {
                     uint32_t cnt, alcnt;
-                    REQ(end - (char*)cmd >= sizeof(recfg_write64_t));
+                    CHK(end - (char*)cmd >= sizeof(recfg_write64_t), kRecfgErrTruncated);
                     recfg_write64_t *w64 = (recfg_write64_t*)cmd;
                     cnt = RECFG_WRITE_COUNT_r(w64) + 1;
                     alcnt = (cnt + 3) & ~3;
-                    REQ(cnt <= 16 && alcnt <= 16 && (alcnt & 3) == 0); // Sanity
-                    REQ(end - (char*)cmd >= sizeof(recfg_write64_t) + alcnt * sizeof(uint8_t) + cnt * sizeof(uint64_t));
+                    CHK(cnt <= 16 && alcnt <= 16 && (alcnt & 3) == 0, kRecfgErrField); // Sanity
+                    CHK(end - (char*)cmd >= sizeof(recfg_write64_t) + alcnt * sizeof(uint8_t) + cnt * sizeof(uint64_t), kRecfgErrTruncated);
                     VOLATILE uint32_t *tmp = (VOLATILE uint32_t*)((VOLATILE uint8_t*)(w64 + 1) + alcnt);
                     if(
 #ifdef RECFG_VOLATILE
@@ -112,7 +295,7 @@ int recfg_check(void *mem, size_t size, size_t *offp, const bool warn)
 #endif
                     )
                     {
-                        REQ(end - (char*)cmd >= sizeof(recfg_write64_t) + alcnt * sizeof(uint8_t) + sizeof(uint32_t) + cnt * sizeof(uint64_t));
+                        CHK(end - (char*)cmd >= sizeof(recfg_write64_t) + alcnt * sizeof(uint8_t) + sizeof(uint32_t) + cnt * sizeof(uint64_t), kRecfgErrTruncated);
                         ++tmp;
                     }
                     VOLATILE uint64_t *datap = (VOLATILE uint64_t*)tmp;
@@ -121,7 +304,7 @@ int recfg_check(void *mem, size_t size, size_t *offp, const bool warn)
                 break;
             default:
                 // This should REALLY be unreachable, but I don't trust anything in this world.
-                REQ(false);
+                CHK(false, kRecfgErrCommand);
         }
     }
 end:;
@@ -129,12 +312,23 @@ end:;
 
 out:;
     if(offp) *offp = (char*)cmd - start;
+    if(ctx && retval == kRecfgSuccess) ctx->off = (char*)cmd - start;
     return retval;
 }
 
-int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
+int recfg_check(void *mem, size_t size, size_t *offp, const bool warn)
+{
+    return recfg_check_internal(mem, size, offp, warn, NULL);
+}
+
+int recfg_check_ctx(void *mem, size_t size, size_t *offp, recfg_ctx_t *ctx)
+{
+    recfg_ctx_init(ctx);
+    return recfg_check_internal(mem, size, offp, false, ctx);
+}
+
+static int recfg_walk_internal(void *mem, size_t size, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a, const bool warn, recfg_ctx_t *ctx, recfg_track_t *track)
 {
-    const bool warn = true; // for macros
     int retval = kRecfgFailure,
         ret    = kRecfgSuccess;
     char *start = mem,
@@ -142,12 +336,25 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
     recfg_cmd_t *cmd = mem;
     while(end - (char*)cmd != 0) // != rather than > because ptrdiff is signed
     {
+        // Length before any callback got to touch the command, for the dirty list
+        size_t cmdlen = track ? recfg_cmd_len(cmd, end - (char*)cmd) : 0;
+        if(filter && !recfg_filter_cmd(filter, cmd))
+        {
+            if(RECFG_CMD_CMD_r(cmd) == kRecfgMeta && RECFG_CMD_META_r(cmd) == kRecfgEnd)
+            {
+                goto end;
+            }
+            size_t len = recfg_cmd_len(cmd, end - (char*)cmd);
+            CHK(len != 0, kRecfgErrCommand);
+            cmd = (recfg_cmd_t*)((char*)cmd + len);
+            continue;
+        }
         if(cb->generic)
         {
             // Make copy on memory that doesn't require volatile access
             recfg_cmd_t copy = *cmd;
             int r = cb->generic(a, &copy);
-            REQ(r != kRecfgUpdate);
+            CHK(r != kRecfgUpdate, kRecfgErrCallback);
             if(r != kRecfgSuccess)
             {
                 retval = r;
@@ -163,7 +370,7 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                         if(cb->end)
                         {
                             int r = cb->end(a);
-                            REQ(r != kRecfgUpdate);
+                            CHK(r != kRecfgUpdate, kRecfgErrCallback);
                             if(r != kRecfgSuccess)
                             {
                                 retval = r;
@@ -178,9 +385,10 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                             int r = cb->delay(a, &data);
                             if(r == kRecfgUpdate)
                             {
-                                REQ(data < (1 << 26));
+                                CHK(data < (1 << 26), kRecfgErrValue);
                                 RECFG_CMD_DATA_w(cmd, data);
                                 ret |= kRecfgUpdate;
+                                recfg_dirty(track, start, cmd, cmdlen);
                             }
                             else if(r != kRecfgSuccess)
                             {
@@ -190,7 +398,7 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                         }
                         break;
                     default:
-                        goto out;
+                        CHK(false, kRecfgErrCommand);
                 }
                 cmd = cmd + 1;
                 break;
@@ -200,9 +408,9 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                     if(!RECFG_READ_LARGE_r(read))
                     {
                         recfg_read32_t *r32 = (recfg_read32_t*)read;
-                        if(cb->r32)
+                        uint64_t addr = ((uint64_t)RECFG_READ_BASE_r(r32) << 10) | ((uint64_t)RECFG_READ_OFF_r(r32) << 2);
+                        if(cb->r32 && recfg_filter_addr(filter, addr))
                         {
-                            uint64_t addr = ((uint64_t)RECFG_READ_BASE_r(r32) << 10) | ((uint64_t)RECFG_READ_OFF_r(r32) << 2);
                             uint32_t mask = r32->mask;
                             uint32_t data = r32->data;
                             bool retry = !!RECFG_READ_RETRY_r(r32);
@@ -210,7 +418,7 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                             int r = cb->r32(a, &addr, &mask, &data, &retry, &recnt);
                             if(r == kRecfgUpdate)
                             {
-                                REQ((addr & 0xfffffff000000003) == 0);
+                                CHK((addr & 0xfffffff000000003) == 0, kRecfgErrAddress);
                                 RECFG_READ_BASE_w(r32, addr >> 10);
                                 RECFG_READ_OFF_w(r32, (addr >> 2) & 0xff);
                                 r32->mask = mask;
@@ -218,6 +426,7 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                                 RECFG_READ_RETRY_w(r32, retry ? 1 : 0);
                                 RECFG_READ_RECNT_w(r32, recnt);
                                 ret |= kRecfgUpdate;
+                                recfg_dirty(track, start, cmd, cmdlen);
                             }
                             else if(r != kRecfgSuccess)
                             {
@@ -244,9 +453,9 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                             ++tmp;
                         }
                         VOLATILE uint64_t *datap = (VOLATILE uint64_t*)tmp;
-                        if(cb->r64)
+                        uint64_t addr = ((uint64_t)RECFG_READ_BASE_r(r64) << 10) | ((uint64_t)RECFG_READ_OFF_r(r64) << 2);
+                        if(cb->r64 && recfg_filter_addr(filter, addr))
                         {
-                            uint64_t addr = ((uint64_t)RECFG_READ_BASE_r(r64) << 10) | ((uint64_t)RECFG_READ_OFF_r(r64) << 2);
                             uint64_t mask = datap[0];
                             uint64_t data = datap[1];
                             bool retry = !!RECFG_READ_RETRY_r(r64);
@@ -254,7 +463,7 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                             int r = cb->r64(a, &addr, &mask, &data, &retry, &recnt);
                             if(r == kRecfgUpdate)
                             {
-                                REQ((addr & 0xfffffff000000003) == 0);
+                                CHK((addr & 0xfffffff000000003) == 0, kRecfgErrAddress);
                                 RECFG_READ_BASE_w(r64, addr >> 10);
                                 RECFG_READ_OFF_w(r64, (addr >> 2) & 0xff);
                                 datap[0] = mask;
@@ -262,6 +471,7 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                                 RECFG_READ_RETRY_w(r64, retry ? 1 : 0);
                                 RECFG_READ_RECNT_w(r64, recnt);
                                 ret |= kRecfgUpdate;
+                                recfg_dirty(track, start, cmd, cmdlen);
                             }
                             else if(r != kRecfgSuccess)
                             {
@@ -285,22 +495,27 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                         for(uint32_t i = 0; i < cnt; ++i)
                         {
                             uint64_t addr = ((uint64_t)RECFG_WRITE_BASE_r(w32) << 10) | ((uint64_t)RECFG_WRITE_OFF_r(w32, i) << 2);
+                            if(!recfg_filter_addr(filter, addr))
+                            {
+                                continue;
+                            }
                             uint32_t data = datap[i];
                             int r = cb->w32(a, &addr, &data);
                             if(r == kRecfgUpdate)
                             {
-                                REQ((addr & 0xfffffff000000003) == 0);
+                                CHK((addr & 0xfffffff000000003) == 0, kRecfgErrAddress);
                                 if(cnt == 1)
                                 {
                                     RECFG_WRITE_BASE_w(w32, addr >> 10);
                                 }
                                 else
                                 {
-                                    REQ((addr & 0xffffffc00) == (RECFG_WRITE_BASE_r(w32) << 10));
+                                    CHK((addr & 0xffffffc00) == ((uint64_t)RECFG_WRITE_BASE_r(w32) << 10), kRecfgErrAddress);
                                 }
                                 RECFG_WRITE_OFF_w(w32, i, (addr >> 2) & 0xff);
                                 datap[i] = data;
                                 ret |= kRecfgUpdate;
+                                recfg_dirty(track, start, cmd, cmdlen);
                             }
                             else if(r != kRecfgSuccess)
                             {
@@ -337,22 +552,27 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                         for(uint32_t i = 0; i < cnt; ++i)
                         {
                             uint64_t addr = ((uint64_t)RECFG_WRITE_BASE_r(w64) << 10) | ((uint64_t)RECFG_WRITE_OFF_r(w64, i) << 2);
+                            if(!recfg_filter_addr(filter, addr))
+                            {
+                                continue;
+                            }
                             uint64_t data = datap[i];
                             int r = cb->w64(a, &addr, &data);
                             if(r == kRecfgUpdate)
                             {
-                                REQ((addr & 0xfffffff000000003) == 0);
+                                CHK((addr & 0xfffffff000000003) == 0, kRecfgErrAddress);
                                 if(cnt == 1)
                                 {
                                     RECFG_WRITE_BASE_w(w64, addr >> 10);
                                 }
                                 else
                                 {
-                                    REQ((addr & 0xffffffc00) == (RECFG_WRITE_BASE_r(w64) << 10));
+                                    CHK((addr & 0xffffffc00) == ((uint64_t)RECFG_WRITE_BASE_r(w64) << 10), kRecfgErrAddress);
                                 }
                                 RECFG_WRITE_OFF_w(w64, i, (addr >> 2) & 0xff);
                                 datap[i] = data;
                                 ret |= kRecfgUpdate;
+                                recfg_dirty(track, start, cmd, cmdlen);
                             }
                             else if(r != kRecfgSuccess)
                             {
@@ -365,12 +585,124 @@ int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
                 }
                 break;
             default:
-                goto out;
+                CHK(false, kRecfgErrCommand);
         }
     }
 end:;
     retval = ret;
 
 out:;
+    if(retval != kRecfgSuccess && retval != kRecfgUpdate && ctx && ctx->err == kRecfgErrNone)
+    {
+        // A callback asked us to stop
+        recfg_fail(ctx, kRecfgErrCallback, "callback", start, cmd);
+    }
     return retval;
 }
+
+int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a)
+{
+    return recfg_walk_internal(mem, size, cb, NULL, a, true, NULL, NULL);
+}
+
+int recfg_walk_filter(void *mem, size_t size, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a)
+{
+    return recfg_walk_internal(mem, size, cb, filter, a, true, NULL, NULL);
+}
+
+int recfg_walk_ctx(void *mem, size_t size, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a, recfg_ctx_t *ctx)
+{
+    recfg_ctx_init(ctx);
+    return recfg_walk_internal(mem, size, cb, filter, a, false, ctx, NULL);
+}
+
+int recfg_walk_track(void *mem, size_t size, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a, recfg_ctx_t *ctx, recfg_track_t *track)
+{
+    recfg_ctx_init(ctx);
+    if(track)
+    {
+        track->num      = 0;
+        track->overflow = false;
+    }
+    return recfg_walk_internal(mem, size, cb, filter, a, false, ctx, track);
+}
+
+int recfg_recheck(void *mem, size_t size, const recfg_track_t *track, recfg_ctx_t *ctx)
+{
+    const bool warn = false; // for macros
+    int retval = kRecfgFailure;
+    recfg_ctx_init(ctx);
+    // Without a dirty list, we don't know what changed
+    if(!track || track->overflow)
+    {
+        return recfg_check_internal(mem, size, NULL, warn, ctx);
+    }
+    char *start = mem;
+    recfg_cmd_t *cmd = mem;
+    for(size_t i = 0; i < track->num; ++i)
+    {
+        const recfg_dirty_t *dirty = &track->dirty[i];
+        // Set first, so that failures report this command rather than the previous one
+        cmd = (recfg_cmd_t*)(start + dirty->off);
+        CHK(dirty->off < size, kRecfgErrTruncated);
+        // Covers the padding probe too, since recfg_cmd_len() does the same one as recfg_check()
+        CHK(recfg_cmd_len(cmd, size - dirty->off) == dirty->len, kRecfgErrValue);
+    }
+    retval = kRecfgSuccess;
+
+out:;
+    return retval;
+}
+
+static int recfg_scan(void *mem, size_t size, size_t *offp, size_t *countp)
+{
+    int retval = kRecfgFailure;
+    size_t count = 0;
+    char *start = mem,
+         *end   = start + size;
+    recfg_cmd_t *cmd = mem;
+    while(end - (char*)cmd != 0) // != rather than > because ptrdiff is signed
+    {
+        if(end - (char*)cmd < sizeof(recfg_cmd_t)) goto out;
+        size_t len = recfg_cmd_len(cmd, end - (char*)cmd);
+        if(len == 0) goto out;
+        if(RECFG_CMD_CMD_r(cmd) == kRecfgMeta && RECFG_CMD_META_r(cmd) == kRecfgEnd)
+        {
+            if(RECFG_CMD_DATA_r(cmd) != 0) goto out;
+            goto end;
+        }
+        cmd = (recfg_cmd_t*)((char*)cmd + len);
+        ++count;
+    }
+end:;
+    retval = kRecfgSuccess;
+
+out:;
+    if(offp) *offp = (char*)cmd - start;
+    if(countp) *countp = count;
+    return retval;
+}
+
+int recfg_skip(void *mem, size_t size, size_t *offp)
+{
+    return recfg_scan(mem, size, offp, NULL);
+}
+
+int recfg_count(void *mem, size_t size, size_t *offp, size_t *countp)
+{
+    return recfg_scan(mem, size, offp, countp);
+}
+
+size_t recfg_cmd_size(void *cmd, size_t avail)
+{
+    if(avail < sizeof(recfg_cmd_t))
+    {
+        return 0;
+    }
+    recfg_cmd_t *c = cmd;
+    if(RECFG_CMD_CMD_r(c) == kRecfgMeta && RECFG_CMD_META_r(c) == kRecfgEnd && RECFG_CMD_DATA_r(c) != 0)
+    {
+        return 0;
+    }
+    return recfg_cmd_len(c, avail);
+}
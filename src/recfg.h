@@ -23,6 +23,17 @@ enum
     // reserved up to 15
 };
 
+enum
+{
+    kRecfgErrNone       = 0,
+    kRecfgErrTruncated  = 1, // Command runs past the end of the buffer
+    kRecfgErrCommand    = 2, // Unknown command or meta type
+    kRecfgErrField      = 3, // Field has a value that isn't allowed
+    kRecfgErrAddress    = 4, // Callback produced an address that can't be encoded
+    kRecfgErrValue      = 5, // Callback produced a value that can't be encoded
+    kRecfgErrCallback   = 6, // Callback returned an error, or kRecfgUpdate where it mustn't
+};
+
 enum
 {
     kRecfgMeta      = 0,
@@ -37,6 +48,17 @@ enum
     kRecfgDelay     = 1,
 };
 
+enum
+{
+    kRecfgOpEnd     = 1 << 0,
+    kRecfgOpDelay   = 1 << 1,
+    kRecfgOpRead32  = 1 << 2,
+    kRecfgOpRead64  = 1 << 3,
+    kRecfgOpWrite32 = 1 << 4,
+    kRecfgOpWrite64 = 1 << 5,
+    kRecfgOpAll     = 0x3f,
+};
+
 #ifdef RECFG_VOLATILE
 
 // For use on actual MMIO / uncached memory with alignment restrictions.
@@ -174,6 +196,40 @@ typedef struct
     recfg_write64_cb_t w64;
 } recfg_cb_t;
 
+typedef struct
+{
+    size_t off;         // Offset of the command
+    size_t len;         // Length of the command, including padding, before it was modified
+} recfg_dirty_t;
+
+typedef struct
+{
+    int err;            // kRecfgErr*
+    size_t off;         // Offset of the failing command, or of the end on success
+    const char *reason; // Static string naming the failed condition, or NULL
+} recfg_ctx_t;
+
+typedef struct
+{
+    recfg_dirty_t *dirty;   // Caller-owned array of `cap` entries
+    size_t cap;
+    size_t num;
+    bool overflow;          // More commands were modified than fit into `dirty`
+} recfg_track_t;
+
+typedef struct
+{
+    uint64_t start;
+    uint64_t end;   // exclusive
+} recfg_range_t;
+
+typedef struct
+{
+    uint32_t ops;                   // kRecfgOp* mask
+    size_t nranges;                 // 0 to match any address
+    const recfg_range_t *ranges;
+} recfg_filter_t;
+
 /**
  * API doc
  *
@@ -217,9 +273,65 @@ typedef struct
  * parsing will stop and the returned value will be passed back to the caller.
  * If any of the callbacks returned `kRecfgUpdate`, recfg_walk() will also do that,
  * and in that case you are responsible for writing `mem` back to where it came from, if applicable.
+ *
+ *
+ * recfg_walk_filter()
+ *
+ * Like recfg_walk(), but only invokes callbacks for operations matching `filter` (which may be NULL).
+ * Commands whose type is not in `ops`, or whose 1KB block doesn't overlap any of the ranges, are
+ * skipped without looking at their offsets or data, and are not passed to `generic` either.
+ * Within commands that pass, individual addresses are matched against the ranges.
+ * kRecfgEnd and kRecfgDelay have no address and are only subject to `ops`.
+ * recfg_filter_match() applies the same rules to a single op of type `op` (a kRecfgOp* value),
+ * for code that has the ops in some other form already.
+ *
+ *
+ * recfg_check_ctx() / recfg_walk_ctx()
+ *
+ * Same as recfg_check() and recfg_walk_filter(), except they never log, and instead record
+ * what went wrong in the caller-owned `ctx` (which is reset first). Nothing in this file
+ * touches global state, so these can be used concurrently on different sequences.
+ * If a callback stops the walk, `err` is kRecfgErrCallback and `reason` is "callback".
+ *
+ *
+ * recfg_walk_track() / recfg_recheck()
+ *
+ * recfg_walk_track() is recfg_walk_ctx() that also records every command a callback modified
+ * into the caller-owned `track`, in order and once per command. Only `dirty` and `cap` need to
+ * be set up front, `num` and `overflow` are reset first.
+ * After it returned kRecfgUpdate on a sequence that passed recfg_check(), recfg_recheck()
+ * re-verifies only the commands recorded in `track`, rather than the whole sequence.
+ * The callbacks can't change a command's type or count, so the only thing that can break is
+ * a command's length, by new data aliasing (or no longer aliasing) the 0xdeadbeef padding word.
+ * If each dirty command still has its old length, every later command is still where it was, and
+ * the result of the original check stands. If `track` is NULL or `overflow` is set, this falls
+ * back to a full check. `ctx` may be NULL, and is otherwise set as with recfg_check_ctx().
+ *
+ *
+ * recfg_skip() / recfg_count()
+ *
+ * These accept exactly the same sequences as recfg_check() and set `offp` the same way,
+ * but never log and get command lengths from a lookup table, so they are much cheaper for
+ * finding sequence boundaries. recfg_count() additionally sets `countp` to the number of
+ * commands that were parsed, not counting the terminating kRecfgEnd.
+ *
+ *
+ * recfg_cmd_size()
+ *
+ * Length of the single command at `cmd`, including padding, using the same table and rules as
+ * recfg_skip(). Returns 0 if the command is invalid or doesn't fit into `avail` bytes.
 **/
 
 int recfg_check(void *mem, size_t size, size_t *offp, const bool warn);
 int recfg_walk(void *mem, size_t size, const recfg_cb_t *cb, void *a);
+int recfg_walk_filter(void *mem, size_t size, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a);
+bool recfg_filter_match(const recfg_filter_t *filter, uint32_t op, uint64_t addr);
+int recfg_check_ctx(void *mem, size_t size, size_t *offp, recfg_ctx_t *ctx);
+int recfg_walk_ctx(void *mem, size_t size, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a, recfg_ctx_t *ctx);
+int recfg_walk_track(void *mem, size_t size, const recfg_cb_t *cb, const recfg_filter_t *filter, void *a, recfg_ctx_t *ctx, recfg_track_t *track);
+int recfg_recheck(void *mem, size_t size, const recfg_track_t *track, recfg_ctx_t *ctx);
+int recfg_skip(void *mem, size_t size, size_t *offp);
+int recfg_count(void *mem, size_t size, size_t *offp, size_t *countp);
+size_t recfg_cmd_size(void *cmd, size_t avail);
 
 #endif
@@ -0,0 +1,240 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#include <stdbool.h>
+#include <stddef.h>             // size_t
+#include <stdint.h>
+#include <stdlib.h>             // qsort, realloc, free, strtoull
+#include <string.h>             // memcpy
+#include <sys/stat.h>           // stat
+
+#include "common.h"
+#include "regdb.h"
+#include "util.h"
+
+#define REGDB_MAXTOK 4
+
+typedef struct
+{
+    const char *str;
+    size_t len;
+} regdb_tok_t;
+
+static bool regdb_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static char* regdb_strdup(const regdb_tok_t *tok)
+{
+    char *str = malloc(tok->len + 1);
+    if(str)
+    {
+        memcpy(str, tok->str, tok->len);
+        str[tok->len] = '\0';
+    }
+    return str;
+}
+
+static bool regdb_num(const regdb_tok_t *tok, uint64_t *val)
+{
+    char buf[0x20];
+    if(tok->len == 0 || tok->len >= sizeof(buf))
+    {
+        return false;
+    }
+    memcpy(buf, tok->str, tok->len);
+    buf[tok->len] = '\0';
+    char *end = NULL;
+    *val = strtoull(buf, &end, 0);
+    return end[0] == '\0';
+}
+
+static int regdb_cmp(const void *a, const void *b)
+{
+    const regdb_reg_t *x = a,
+                      *y = b;
+    return x->base < y->base ? -1 : x->base > y->base ? 1 : 0;
+}
+
+static int regdb_parse(void *mem, size_t size, void *a)
+{
+    const bool warn = true; // for macros
+    int retval = -1;
+    regdb_t *db = a;
+    size_t regcap = 0,
+           fieldcap = 0,
+           lineno = 0;
+    const char *cur = mem,
+               *end = cur + size;
+    while(cur < end)
+    {
+        const char *eol = memchr(cur, '\n', end - cur);
+        if(!eol) eol = end;
+        ++lineno;
+        bool indent = regdb_space(*cur);
+        regdb_tok_t tok[REGDB_MAXTOK];
+        size_t ntok = 0;
+        for(const char *p = cur; p < eol && *p != '#'; )
+        {
+            if(regdb_space(*p))
+            {
+                ++p;
+                continue;
+            }
+            const char *s = p;
+            while(p < eol && !regdb_space(*p) && *p != '#') ++p;
+            if(ntok >= REGDB_MAXTOK)
+            {
+                ERR("regdb line %lu: too many tokens", lineno);
+                goto out;
+            }
+            tok[ntok++] = (regdb_tok_t){ .str = s, .len = p - s };
+        }
+        cur = eol + 1;
+        if(ntok == 0)
+        {
+            continue;
+        }
+        if(!indent)
+        {
+            uint64_t base = 0,
+                     rsize = 4;
+            if(ntok < 2 || ntok > 3 || !regdb_num(&tok[1], &base) || (ntok == 3 && !regdb_num(&tok[2], &rsize)) || rsize == 0)
+            {
+                ERR("regdb line %lu: expected \"name base [size]\"", lineno);
+                goto out;
+            }
+            if(db->nreg >= regcap)
+            {
+                regcap = regcap ? regcap * 2 : 0x100;
+                regdb_reg_t *reg = realloc(db->reg, regcap * sizeof(*reg));
+                REQ(reg);
+                db->reg = reg;
+            }
+            regdb_reg_t *reg = &db->reg[db->nreg];
+            *reg = (regdb_reg_t){ .name = regdb_strdup(&tok[0]), .base = base, .size = rsize, .first_field = db->nfield, .nfields = 0 };
+            REQ(reg->name);
+            ++db->nreg;
+        }
+        else
+        {
+            uint64_t lsb = 0,
+                     width = 0;
+            if(db->nreg == 0 || ntok != 3 || !regdb_num(&tok[1], &lsb) || !regdb_num(&tok[2], &width) || width == 0 || lsb + width > 64)
+            {
+                ERR("regdb line %lu: expected \"name lsb width\" below a register", lineno);
+                goto out;
+            }
+            if(db->nfield >= fieldcap)
+            {
+                fieldcap = fieldcap ? fieldcap * 2 : 0x100;
+                regdb_field_t *field = realloc(db->field, fieldcap * sizeof(*field));
+                REQ(field);
+                db->field = field;
+            }
+            regdb_field_t *field = &db->field[db->nfield];
+            *field = (regdb_field_t){ .name = regdb_strdup(&tok[0]), .lsb = lsb, .width = width };
+            REQ(field->name);
+            ++db->nfield;
+            ++db->reg[db->nreg - 1].nfields;
+        }
+    }
+    // Fields are referenced by index, so they stay valid
+    qsort(db->reg, db->nreg, sizeof(*db->reg), &regdb_cmp);
+    for(size_t i = 1; i < db->nreg; ++i)
+    {
+        if(db->reg[i - 1].base + db->reg[i - 1].size > db->reg[i].base)
+        {
+            ERR("regdb: %s overlaps %s", db->reg[i - 1].name, db->reg[i].name);
+            goto out;
+        }
+    }
+    retval = 0;
+
+out:;
+    return retval;
+}
+
+int regdb_load(const char *path, regdb_t *db)
+{
+    *db = (regdb_t){};
+    // file2mem() can't map an empty file, but that's just an empty database
+    struct stat s;
+    if(stat(path, &s) == 0 && S_ISREG(s.st_mode) && s.st_size == 0)
+    {
+        return 0;
+    }
+    int retval = file2mem(path, &regdb_parse, db);
+    if(retval != 0)
+    {
+        regdb_free(db);
+    }
+    return retval;
+}
+
+void regdb_free(regdb_t *db)
+{
+    for(size_t i = 0; i < db->nreg; ++i)
+    {
+        if(db->reg[i].name) free(db->reg[i].name);
+    }
+    for(size_t i = 0; i < db->nfield; ++i)
+    {
+        if(db->field[i].name) free(db->field[i].name);
+    }
+    if(db->reg) free(db->reg);
+    if(db->field) free(db->field);
+    *db = (regdb_t){};
+}
+
+const regdb_reg_t* regdb_lookup(const regdb_t *db, uint64_t addr)
+{
+    // Find the last register with base <= addr
+    size_t lo = 0,
+           hi = db->nreg;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(db->reg[mid].base <= addr) lo = mid + 1;
+        else                          hi = mid;
+    }
+    if(lo == 0)
+    {
+        return NULL;
+    }
+    const regdb_reg_t *reg = &db->reg[lo - 1];
+    return addr - reg->base < reg->size ? reg : NULL;
+}
+
+void regdb_annotate(const regdb_t *db, buf_t *out, uint64_t addr, uint64_t val, uint64_t mask)
+{
+    const regdb_reg_t *reg = regdb_lookup(db, addr);
+    if(!reg)
+    {
+        return;
+    }
+    uint64_t off = addr - reg->base;
+    if(off)
+    {
+        buf_printf(out, "  ; %s+0x%llx", reg->name, off);
+        return;
+    }
+    buf_printf(out, "  ; %s", reg->name);
+    for(size_t i = reg->first_field, e = reg->first_field + reg->nfields; i < e; ++i)
+    {
+        const regdb_field_t *field = &db->field[i];
+        uint64_t fmask = (field->width == 64 ? ~0ULL : ((1ULL << field->width) - 1)) << field->lsb;
+        if(mask & fmask)
+        {
+            buf_printf(out, " %s=0x%llx", field->name, (val & fmask) >> field->lsb);
+        }
+    }
+}
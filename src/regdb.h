@@ -0,0 +1,63 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#ifndef REGDB_H
+#define REGDB_H
+
+#include <stddef.h>             // size_t
+#include <stdint.h>
+
+#include "util.h"
+
+/**
+ * Register database, loaded from a text file like this:
+ *
+ *     # Comment
+ *     AMCC_CTRL 0x200000010 4
+ *         EN    0 1
+ *         MODE  4 3
+ *
+ * Register lines are `name base [size]`, size defaulting to 4. Indented lines are
+ * `name lsb width` and describe fields of the register above. Registers must not overlap.
+ * Lookups are a binary search over registers sorted by base.
+**/
+
+typedef struct
+{
+    char *name;
+    uint8_t lsb;
+    uint8_t width;
+} regdb_field_t;
+
+typedef struct
+{
+    char *name;
+    uint64_t base;
+    uint64_t size;
+    size_t first_field;
+    size_t nfields;
+} regdb_reg_t;
+
+typedef struct
+{
+    regdb_reg_t *reg;
+    size_t nreg;
+    regdb_field_t *field;
+    size_t nfield;
+} regdb_t;
+
+int regdb_load(const char *path, regdb_t *db);
+void regdb_free(regdb_t *db);
+const regdb_reg_t* regdb_lookup(const regdb_t *db, uint64_t addr);
+
+// Appends "  ; NAME[+off] [FIELD=val ...]" for `addr` if it is known. Only fields overlapping `mask` are shown.
+void regdb_annotate(const regdb_t *db, buf_t *out, uint64_t addr, uint64_t val, uint64_t mask);
+
+#endif
@@ -0,0 +1,632 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#include <errno.h>
+#include <pthread.h>            // pthread_sigmask
+#include <signal.h>             // signal, sigaction, sigemptyset, sigaddset, sigdelset, sig_atomic_t
+#include <stdbool.h>
+#include <stddef.h>             // size_t
+#include <stdint.h>
+#include <stdlib.h>             // calloc, malloc, free
+#include <string.h>             // memchr, strcmp, strcpy, strdup, strerror, strlen, strtok_r
+#include <sys/select.h>         // pselect, fd_set
+#include <sys/socket.h>         // socket, bind, listen, accept, recv, send, setsockopt
+#include <sys/stat.h>           // stat, lstat
+#include <sys/time.h>           // timeval
+#include <sys/un.h>             // sockaddr_un
+#include <time.h>               // timespec
+#include <unistd.h>             // close, unlink
+
+#include "common.h"
+#include "main.h"
+#include "pack.h"
+#include "recfg.h"
+#include "serve.h"
+#include "trace.h"
+#include "util.h"
+
+#define SERVE_MAXREQ    0x1000
+#define SERVE_MAXARGS   0x40
+#define SERVE_BACKLOG   0x10
+#define SERVE_TIMEOUT   5       // Seconds
+
+#ifdef __APPLE__
+#   define ST_MTIM(s) ((s).st_mtimespec)
+#else
+#   define ST_MTIM(s) ((s).st_mtim)
+#endif
+
+// A decoded image. Only the decoded form is kept, the mapping goes away once decoding is done.
+typedef struct serve_ent
+{
+    struct serve_ent *prev;
+    struct serve_ent *next;
+    char *path;
+    uint32_t flags;
+    dev_t dev;
+    ino_t ino;
+    off_t fsize;
+    struct timespec mtime;  // Full resolution, a rewrite within the same second must still count
+    size_t cost;
+    bool busy;  // In use by the current request, not evictable
+    pack_t pack;
+} serve_ent_t;
+
+typedef struct
+{
+    serve_ent_t *head;  // Most recently used
+    serve_ent_t *tail;
+    size_t used;
+    size_t max;
+} serve_cache_t;
+
+typedef struct
+{
+    const char *cmd;
+    uint32_t flags;
+    recfg_filter_t filter;
+    recfg_range_t ranges[SERVE_MAXARGS];
+    bool filtered;
+    const char *path[2];
+    size_t npath;
+} serve_req_t;
+
+static void cache_unlink(serve_cache_t *cache, serve_ent_t *ent)
+{
+    if(ent->prev) ent->prev->next = ent->next;
+    else          cache->head     = ent->next;
+    if(ent->next) ent->next->prev = ent->prev;
+    else          cache->tail     = ent->prev;
+    ent->prev = ent->next = NULL;
+}
+
+static void cache_front(serve_cache_t *cache, serve_ent_t *ent)
+{
+    ent->next = cache->head;
+    if(cache->head) cache->head->prev = ent;
+    else            cache->tail       = ent;
+    cache->head = ent;
+}
+
+static void cache_drop(serve_cache_t *cache, serve_ent_t *ent)
+{
+    cache_unlink(cache, ent);
+    cache->used -= ent->cost;
+    pack_free(&ent->pack);
+    free(ent->path);
+    free(ent);
+}
+
+// Evicts from the tail until we fit, skipping entries the current request is using.
+static void cache_trim(serve_cache_t *cache)
+{
+    for(serve_ent_t *ent = cache->tail; ent && cache->used > cache->max; )
+    {
+        serve_ent_t *prev = ent->prev;
+        if(!ent->busy)
+        {
+            cache_drop(cache, ent);
+        }
+        ent = prev;
+    }
+}
+
+static size_t cache_cost(const serve_ent_t *ent)
+{
+    return sizeof(*ent) + strlen(ent->path) + 1
+         + ent->pack.seqcap * sizeof(*ent->pack.seq)
+         + ent->pack.strcap
+         + ent->pack.opcap * (sizeof(*ent->pack.op) + sizeof(*ent->pack.addr) + sizeof(*ent->pack.val) + sizeof(*ent->pack.mask));
+}
+
+static serve_ent_t* cache_get(serve_cache_t *cache, const char *path, uint32_t flags, buf_t *out)
+{
+    struct stat s;
+    if(stat(path, &s) != 0)
+    {
+        buf_printf(out, "error: %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    for(serve_ent_t *ent = cache->head; ent; ent = ent->next)
+    {
+        if(ent->flags != flags || strcmp(ent->path, path) != 0)
+        {
+            continue;
+        }
+        if(ent->dev == s.st_dev && ent->ino == s.st_ino && ent->fsize == s.st_size &&
+           ent->mtime.tv_sec == ST_MTIM(s).tv_sec && ent->mtime.tv_nsec == ST_MTIM(s).tv_nsec)
+        {
+            cache_unlink(cache, ent);
+            cache_front(cache, ent);
+            ent->busy = true;
+            return ent;
+        }
+        // Stale, decode it again below
+        if(!ent->busy) cache_drop(cache, ent);
+        break;
+    }
+
+    serve_ent_t *ent = calloc(1, sizeof(*ent));
+    if(!ent || !(ent->path = strdup(path)))
+    {
+        free(ent);
+        buf_printf(out, "error: out of memory\n");
+        return NULL;
+    }
+    ent->flags = flags;
+    ent->dev   = s.st_dev;
+    ent->ino   = s.st_ino;
+    ent->fsize = s.st_size;
+    ent->mtime = ST_MTIM(s);
+    recfg_arg_t arg =
+    {
+        .off    = 0,
+        .len    = 0,
+        .flags  = flags,
+        .filter = NULL,
+        .pack   = &ent->pack,
+    };
+    uint64_t t = trace_begin();
+    int r = file2mem(path, &recfg, &arg);
+    trace_end("serve_decode", t, TRACE_NOARG);
+    if(r != 0 || ent->pack.oom)
+    {
+        buf_printf(out, "error: %s: failed to decode\n", path);
+        pack_free(&ent->pack);
+        free(ent->path);
+        free(ent);
+        return NULL;
+    }
+    ent->cost = cache_cost(ent);
+    cache->used += ent->cost;
+    cache_front(cache, ent);
+    ent->busy = true;
+    cache_trim(cache);
+    return ent;
+}
+
+static bool serve_parse(char *line, serve_req_t *req, buf_t *out)
+{
+    *req = (serve_req_t){};
+    req->filter.ops = kRecfgOpAll;
+    req->filter.ranges = req->ranges;
+    char *save = NULL;
+    req->cmd = strtok_r(line, " \t\r\n", &save);
+    if(!req->cmd)
+    {
+        buf_printf(out, "error: empty request\n");
+        return false;
+    }
+    for(char *tok; (tok = strtok_r(NULL, " \t\r\n", &save)); )
+    {
+        if(tok[0] != '-' || tok[1] == '\0' || tok[2] != '\0')
+        {
+            if(req->npath >= 2)
+            {
+                buf_printf(out, "error: too many files\n");
+                return false;
+            }
+            req->path[req->npath++] = tok;
+            continue;
+        }
+        switch(tok[1])
+        {
+            case 's': req->flags |= kFlagSearch; break;
+            case 'S': req->flags |= kFlagScan;   break;
+            case 'c': req->flags |= kFlagCarve;  break;
+            case 'a':
+            case 'o':
+                {
+                    char *val = strtok_r(NULL, " \t\r\n", &save);
+                    if(!val)
+                    {
+                        buf_printf(out, "error: %s needs an argument\n", tok);
+                        return false;
+                    }
+                    if(tok[1] == 'o')
+                    {
+                        if(!parse_ops(val, &req->filter.ops))
+                        {
+                            buf_printf(out, "error: bad op list: %s\n", val);
+                            return false;
+                        }
+                    }
+                    else if(req->filter.nranges >= SERVE_MAXARGS || !parse_range(val, &req->ranges[req->filter.nranges++]))
+                    {
+                        buf_printf(out, "error: bad address range: %s\n", val);
+                        return false;
+                    }
+                    req->filtered = true;
+                }
+                break;
+            default:
+                buf_printf(out, "error: unknown option: %s\n", tok);
+                return false;
+        }
+    }
+    if((req->flags & (req->flags - 1)) != 0)
+    {
+        buf_printf(out, "error: at most one of -s, -S, -c\n");
+        return false;
+    }
+    return true;
+}
+
+static void serve_dump(const pack_view_t *view, const recfg_filter_t *filter, buf_t *out)
+{
+    for(uint64_t i = 0; i < view->nseq; ++i)
+    {
+        if(recfg_dump_seq(view, i, filter, out) != kRecfgSuccess)
+        {
+            buf_printf(out, "error: sequence %llu\n", i);
+            return;
+        }
+    }
+}
+
+static void serve_stats(const pack_view_t *view, buf_t *out)
+{
+    static const struct
+    {
+        uint8_t type;
+        const char *name;
+    } ops[] =
+    {
+        { kRecfgOpEnd,     "end"   },
+        { kRecfgOpDelay,   "delay" },
+        { kRecfgOpRead32,  "rd32"  },
+        { kRecfgOpRead64,  "rd64"  },
+        { kRecfgOpWrite32, "wr32"  },
+        { kRecfgOpWrite64, "wr64"  },
+    };
+    uint64_t count[sizeof(ops)/sizeof(ops[0])] = {},
+             lo = ~0ULL,
+             hi = 0;
+    for(uint64_t i = 0; i < view->nops; ++i)
+    {
+        uint8_t type = view->op[i].type;
+        for(size_t j = 0; j < sizeof(ops)/sizeof(ops[0]); ++j)
+        {
+            if(type == ops[j].type) ++count[j];
+        }
+        if(!(type & (kRecfgOpEnd | kRecfgOpDelay)))
+        {
+            if(view->addr[i] < lo) lo = view->addr[i];
+            if(view->addr[i] > hi) hi = view->addr[i];
+        }
+    }
+    // Image lines from -S are entries without ops
+    uint64_t nseq = 0;
+    for(uint64_t i = 0; i < view->nseq; ++i)
+    {
+        if(view->seq[i].nops) ++nseq;
+    }
+    buf_printf(out, "sequences %llu\n", nseq);
+    buf_printf(out, "ops %llu\n", view->nops);
+    for(size_t j = 0; j < sizeof(ops)/sizeof(ops[0]); ++j)
+    {
+        buf_printf(out, "%s %llu\n", ops[j].name, count[j]);
+    }
+    if(lo <= hi)
+    {
+        buf_printf(out, "addr 0x%llx-0x%llx\n", lo, hi);
+    }
+}
+
+static bool serve_op_eq(const pack_view_t *a, uint64_t i, const pack_view_t *b, uint64_t j)
+{
+    return a->op[i].type == b->op[j].type && a->op[i].retry == b->op[j].retry && a->op[i].recnt == b->op[j].recnt &&
+           a->addr[i] == b->addr[j] && a->val[i] == b->val[j] && a->mask[i] == b->mask[j];
+}
+
+// Prints a single op of `view` by walking a one-op sequence over it, so it looks exactly like a dump.
+static void serve_op_line(const pack_view_t *view, uint64_t i, char sign, buf_t *out, buf_t *tmp)
+{
+    pack_seq_t seq = { .first_op = i, .nops = 1 };
+    pack_view_t one = *view;
+    one.nseq = 1;
+    one.seq  = &seq;
+    tmp->len = 0;
+    pack_walk(&one, 0, &recfg_print_cb, NULL, tmp);
+    while(tmp->len > 0 && tmp->buf[tmp->len - 1] == '\n') --tmp->len;
+    buf_printf(out, "%c %.*s\n", sign, (int)tmp->len, tmp->buf);
+}
+
+// Collects the ops of sequence `idx` that pass `filter`, so the filtered views can be diffed.
+static uint64_t* serve_ops(const pack_view_t *view, uint64_t idx, const recfg_filter_t *filter, uint64_t *num)
+{
+    const pack_seq_t *seq = &view->seq[idx];
+    uint64_t *ops = malloc((seq->nops ? seq->nops : 1) * sizeof(*ops)),
+             n = 0;
+    if(!ops)
+    {
+        return NULL;
+    }
+    for(uint64_t i = seq->first_op; i < seq->first_op + seq->nops; ++i)
+    {
+        if(!filter || recfg_filter_match(filter, view->op[i].type, view->addr[i]))
+        {
+            ops[n++] = i;
+        }
+    }
+    *num = n;
+    return ops;
+}
+
+// Per sequence index, trims the common prefix and suffix and prints what's left in between.
+static void serve_diff(const pack_view_t *a, const pack_view_t *b, const recfg_filter_t *filter, buf_t *out)
+{
+    buf_t tmp = {};
+    uint64_t nseq = a->nseq > b->nseq ? a->nseq : b->nseq;
+    bool same = true;
+    for(uint64_t s = 0; s < nseq; ++s)
+    {
+        uint64_t na = 0,
+                 nb = 0,
+                 *oa = s < a->nseq ? serve_ops(a, s, filter, &na) : NULL,
+                 *ob = s < b->nseq ? serve_ops(b, s, filter, &nb) : NULL;
+        if((s < a->nseq && !oa) || (s < b->nseq && !ob))
+        {
+            buf_printf(out, "error: out of memory\n");
+            free(oa);
+            free(ob);
+            break;
+        }
+        uint64_t pre = 0,
+                 suf = 0;
+        while(pre < na && pre < nb && serve_op_eq(a, oa[pre], b, ob[pre])) ++pre;
+        while(suf < na - pre && suf < nb - pre && serve_op_eq(a, oa[na - 1 - suf], b, ob[nb - 1 - suf])) ++suf;
+        if(pre + suf < na || pre + suf < nb || (s < a->nseq) != (s < b->nseq))
+        {
+            same = false;
+            buf_printf(out, "@@ seq %llu", s);
+            if(s < a->nseq) buf_printf(out, " -0x%llx", a->seq[s].src_off);
+            if(s < b->nseq) buf_printf(out, " +0x%llx", b->seq[s].src_off);
+            buf_printf(out, "\n");
+            for(uint64_t i = pre; i < na - suf; ++i) serve_op_line(a, oa[i], '-', out, &tmp);
+            for(uint64_t i = pre; i < nb - suf; ++i) serve_op_line(b, ob[i], '+', out, &tmp);
+        }
+        free(oa);
+        free(ob);
+    }
+    if(same)
+    {
+        buf_printf(out, "identical\n");
+    }
+    buf_free(&tmp);
+}
+
+static void serve_request(serve_cache_t *cache, char *line, buf_t *out)
+{
+    serve_req_t req;
+    if(!serve_parse(line, &req, out))
+    {
+        return;
+    }
+    bool diff = strcmp(req.cmd, "diff") == 0;
+    if(!diff && strcmp(req.cmd, "dump") != 0 && strcmp(req.cmd, "filter") != 0 && strcmp(req.cmd, "stats") != 0)
+    {
+        buf_printf(out, "error: unknown request: %s\n", req.cmd);
+        return;
+    }
+    if(req.npath != (diff ? 2 : 1))
+    {
+        buf_printf(out, "error: %s takes %d file(s)\n", req.cmd, diff ? 2 : 1);
+        return;
+    }
+    if(strcmp(req.cmd, "filter") == 0 && !req.filtered)
+    {
+        buf_printf(out, "error: filter needs -a or -o\n");
+        return;
+    }
+    const recfg_filter_t *filter = req.filtered ? &req.filter : NULL;
+    serve_ent_t *ent[2] = {};
+    for(size_t i = 0; i < req.npath; ++i)
+    {
+        ent[i] = cache_get(cache, req.path[i], req.flags, out);
+        if(!ent[i])
+        {
+            goto out;
+        }
+    }
+    pack_view_t view[2];
+    for(size_t i = 0; i < req.npath; ++i)
+    {
+        pack_view_mem(&ent[i]->pack, &view[i]);
+    }
+    if(diff)
+    {
+        serve_diff(&view[0], &view[1], filter, out);
+    }
+    else if(strcmp(req.cmd, "stats") == 0)
+    {
+        serve_stats(&view[0], out);
+    }
+    else
+    {
+        serve_dump(&view[0], filter, out);
+    }
+
+out:;
+    for(size_t i = 0; i < req.npath; ++i)
+    {
+        if(ent[i]) ent[i]->busy = false;
+    }
+    // Entries that were pinned above may have pushed us over the limit
+    cache_trim(cache);
+}
+
+static void serve_conn(serve_cache_t *cache, int fd)
+{
+    char line[SERVE_MAXREQ];
+    size_t len = 0;
+    bool timeout = false;
+    // Connections are handled one at a time, so a client that stalls mustn't hold up everyone else
+    struct timeval tv = { .tv_sec = SERVE_TIMEOUT, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    while(len < sizeof(line) - 1)
+    {
+        ssize_t r = recv(fd, line + len, sizeof(line) - 1 - len, 0);
+        if(r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            timeout = true;
+            break;
+        }
+        if(r <= 0)
+        {
+            break;
+        }
+        len += r;
+        if(memchr(line + len - r, '\n', r))
+        {
+            break;
+        }
+    }
+    line[len] = '\0';
+
+    buf_t out = {};
+    if(timeout)
+    {
+        buf_printf(&out, "error: timeout\n");
+    }
+    else if(len == 0 || (len == sizeof(line) - 1 && !memchr(line, '\n', len)))
+    {
+        buf_printf(&out, "error: bad request\n");
+    }
+    else
+    {
+        uint64_t t = trace_begin();
+        serve_request(cache, line, &out);
+        trace_end("serve_request", t, TRACE_NOARG);
+    }
+    if(out.oom)
+    {
+        out.len = 0;
+        out.oom = false;
+        buf_printf(&out, "error: out of memory\n");
+    }
+    for(size_t pos = 0; pos < out.len; )
+    {
+        ssize_t r = send(fd, out.buf + pos, out.len - pos, 0);
+        if(r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(r <= 0)
+        {
+            break;
+        }
+        pos += r;
+    }
+    buf_free(&out);
+}
+
+static volatile sig_atomic_t serve_stop = 0;
+
+static void serve_signal(int sig)
+{
+    serve_stop = 1;
+}
+
+int serve(const char *path, size_t maxmem)
+{
+    const bool warn = true; // for macros
+    int retval = -1;
+    int sock = -1;
+    bool bound = false,
+         masked = false;
+    sigset_t sigs, orig, waitset;
+    serve_cache_t cache =
+    {
+        .head = NULL,
+        .tail = NULL,
+        .used = 0,
+        .max  = maxmem,
+    };
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if(strlen(path) >= sizeof(addr.sun_path))
+    {
+        ERR("Socket path too long: %s", path);
+        goto out;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Only ever remove a stale socket, never a regular file
+    struct stat s;
+    if(lstat(path, &s) == 0)
+    {
+        REQ(S_ISSOCK(s.st_mode));
+        REQ(unlink(path) == 0);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    // We leave the loop on SIGINT/SIGTERM rather than dying, so main() returns normally and atexit
+    // handlers like the trace writer get to run. The signals stay blocked except while pselect()
+    // waits, so one can't slip in between checking serve_stop and going to sleep. Worker threads
+    // are started later and inherit the mask, so they never take the signal either.
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    REQ(pthread_sigmask(SIG_BLOCK, &sigs, &orig) == 0);
+    masked = true;
+    waitset = orig;
+    sigdelset(&waitset, SIGINT);
+    sigdelset(&waitset, SIGTERM);
+    struct sigaction sa = { .sa_handler = &serve_signal };
+    sigemptyset(&sa.sa_mask);
+    REQ(sigaction(SIGINT, &sa, NULL) == 0);
+    REQ(sigaction(SIGTERM, &sa, NULL) == 0);
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    REQ(sock != -1);
+    REQ(bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    bound = true;
+    REQ(listen(sock, SERVE_BACKLOG) == 0);
+
+    while(!serve_stop)
+    {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(sock, &rfds);
+        if(pselect(sock + 1, &rfds, NULL, NULL, NULL, &waitset) == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            ERR("pselect: %s", strerror(errno));
+            goto out;
+        }
+        int fd = accept(sock, NULL, NULL);
+        if(fd == -1)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            ERR("accept: %s", strerror(errno));
+            goto out;
+        }
+        serve_conn(&cache, fd);
+        close(fd);
+    }
+    retval = 0;
+
+out:;
+    while(cache.head) cache_drop(&cache, cache.head);
+    if(sock != -1) close(sock);
+    if(bound) unlink(path);
+    if(masked) pthread_sigmask(SIG_SETMASK, &orig, NULL);
+    return retval;
+}
@@ -0,0 +1,31 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stddef.h>             // size_t
+
+/**
+ * Query daemon on a Unix socket. Each connection sends one line and gets the answer back,
+ * after which the connection is closed:
+ *
+ *     dump   [-s|-S|-c] [-a start-end]... [-o op,...] file
+ *     filter [-s|-S|-c] [-a start-end]... [-o op,...] file
+ *     stats  [-s|-S|-c] file
+ *     diff   [-s|-S|-c] [-a start-end]... [-o op,...] file1 file2
+ *
+ * Decoded images are kept in an LRU cache bounded by `maxmem` bytes, keyed on path and mode,
+ * and are re-decoded if the file changed on disk. Paths cannot contain whitespace.
+**/
+
+int serve(const char *path, size_t maxmem);
+
+#endif
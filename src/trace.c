@@ -0,0 +1,189 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>             // size_t
+#include <stdint.h>
+#include <stdio.h>              // FILE, fopen, fprintf, fclose
+#include <stdlib.h>             // atexit, calloc, free
+#include <time.h>               // clock_gettime
+
+#include "common.h"
+#include "trace.h"
+
+#define TRACE_RING 0x4000
+
+typedef struct
+{
+    const char *name;
+    uint64_t ts;
+    uint64_t dur;
+    uint64_t arg;
+} trace_ev_t;
+
+typedef struct trace_ring
+{
+    struct trace_ring *next;
+    struct trace_ring *free;    // Next unowned ring, valid while on trace_free
+    uint32_t tid;
+    size_t pos; // Total number of events ever recorded
+    trace_ev_t ev[TRACE_RING];
+} trace_ring_t;
+
+static bool trace_enabled = false;
+static uint64_t trace_t0 = 0;
+static FILE *trace_file = NULL;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_ring_t *trace_rings = NULL;
+static trace_ring_t *trace_free = NULL;
+static uint32_t trace_tids = 0;
+static pthread_key_t trace_key;
+static _Thread_local trace_ring_t *trace_self = NULL;
+
+static uint64_t trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Runs when a thread that recorded events exits. Its events are kept, but the ring goes to the next new thread.
+static void trace_release(void *a)
+{
+    trace_ring_t *ring = a;
+    pthread_mutex_lock(&trace_lock);
+    ring->free = trace_free;
+    trace_free = ring;
+    pthread_mutex_unlock(&trace_lock);
+}
+
+static trace_ring_t* trace_ring(void)
+{
+    if(!trace_self)
+    {
+        pthread_mutex_lock(&trace_lock);
+        trace_ring_t *ring = trace_free;
+        if(ring)
+        {
+            trace_free = ring->free;
+        }
+        else
+        {
+            ring = calloc(1, sizeof(*ring));
+            if(ring)
+            {
+                ring->tid = trace_tids++;
+                ring->next = trace_rings;
+                trace_rings = ring;
+            }
+        }
+        pthread_mutex_unlock(&trace_lock);
+        if(!ring)
+        {
+            return NULL;
+        }
+        pthread_setspecific(trace_key, ring);
+        trace_self = ring;
+    }
+    return trace_self;
+}
+
+static void trace_write(void)
+{
+    const bool warn = true; // for macros
+    bool first = true;
+    trace_enabled = false;
+    pthread_key_delete(trace_key); // Rings are freed below, threads still running must not hand them back
+    pthread_mutex_lock(&trace_lock);
+    fprintf(trace_file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for(trace_ring_t *ring = trace_rings; ring; ring = ring->next)
+    {
+        size_t n   = ring->pos < TRACE_RING ? ring->pos : TRACE_RING,
+               idx = ring->pos - n;
+        for(size_t i = 0; i < n; ++i)
+        {
+            const trace_ev_t *ev = &ring->ev[(idx + i) % TRACE_RING];
+            fprintf(trace_file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu",
+                    first ? "" : ",", ev->name, ring->tid, ev->ts / 1000, ev->ts % 1000, ev->dur / 1000, ev->dur % 1000);
+            if(ev->arg != TRACE_NOARG)
+            {
+                fprintf(trace_file, ",\"args\":{\"off\":\"0x%llx\"}", ev->arg);
+            }
+            fprintf(trace_file, "}");
+            first = false;
+        }
+    }
+    fprintf(trace_file, "\n]}\n");
+    pthread_mutex_unlock(&trace_lock);
+    REQ(fclose(trace_file) == 0);
+out:;
+    trace_file = NULL;
+    while(trace_rings)
+    {
+        trace_ring_t *next = trace_rings->next;
+        free(trace_rings);
+        trace_rings = next;
+    }
+    trace_free = NULL;
+}
+
+int trace_init(const char *path)
+{
+    const bool warn = true; // for macros
+    int retval = -1;
+    bool key = false;
+
+    REQ(!trace_enabled);
+    trace_file = fopen(path, "w");
+    REQ(trace_file);
+    REQ(pthread_key_create(&trace_key, &trace_release) == 0);
+    key = true;
+    REQ(atexit(&trace_write) == 0);
+
+    trace_t0 = trace_now();
+    trace_enabled = true;
+    retval = 0;
+out:;
+    if(retval != 0 && key)
+    {
+        pthread_key_delete(trace_key);
+    }
+    if(retval != 0 && trace_file)
+    {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+    return retval;
+}
+
+uint64_t trace_begin(void)
+{
+    return trace_enabled ? trace_now() : 0;
+}
+
+void trace_end(const char *name, uint64_t start, uint64_t arg)
+{
+    if(!trace_enabled)
+    {
+        return;
+    }
+    uint64_t now = trace_now();
+    trace_ring_t *ring = trace_ring();
+    if(!ring)
+    {
+        return;
+    }
+    trace_ev_t *ev = &ring->ev[ring->pos++ % TRACE_RING];
+    ev->name = name;
+    ev->ts   = start - trace_t0;
+    ev->dur  = now - start;
+    ev->arg  = arg;
+}
@@ -0,0 +1,31 @@
+/* Copyright (c) 2020 Siguza
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+**/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_NOARG UINT64_MAX
+
+/**
+ * Phase tracing, written out as Chrome trace JSON (chrome://tracing, Perfetto) at exit.
+ *
+ * Until trace_init() has been called, trace_begin() returns 0 and trace_end() is a no-op.
+ * Each thread records into its own ring buffer, so only the most recent events per thread are kept.
+ * A ring outlives its thread and is reused by the next thread that starts recording, which shows up under the same tid.
+ * `name` must be a string literal or otherwise outlive the process.
+**/
+
+int trace_init(const char *path);
+uint64_t trace_begin(void);
+void trace_end(const char *name, uint64_t start, uint64_t arg);
+
+#endif
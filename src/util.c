@@ -9,13 +9,20 @@
 **/
 
 #include <fcntl.h>              // open
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>             // size_t
-#include <unistd.h>             // close
+#include <stdarg.h>             // va_list, va_start, va_end
+#include <stdint.h>
+#include <stdio.h>              // vsnprintf
+#include <stdlib.h>             // realloc, free
+#include <unistd.h>             // close, sysconf
 #include <sys/mman.h>           // mmap, munmap
 #include <sys/stat.h>           // fstat
 
 #include "common.h"
+#include "trace.h"
 #include "util.h"
 
 int file2mem(const char *path, int (*func)(void*, size_t, void*), void *arg)
@@ -25,6 +32,7 @@ int file2mem(const char *path, int (*func)(void*, size_t, void*), void *arg)
     int fd = -1;
     void *mem = MAP_FAILED;
     size_t size = 0;
+    uint64_t t = trace_begin();
 
     fd = open(path, O_RDONLY);
     REQ(fd != -1);
@@ -35,6 +43,7 @@ int file2mem(const char *path, int (*func)(void*, size_t, void*), void *arg)
 
     mem = mmap(NULL, size, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0);
     REQ(mem != MAP_FAILED);
+    trace_end("file2mem", t, TRACE_NOARG);
 
     retval = func(mem, size, arg);
 out:;
@@ -42,3 +51,172 @@ out:;
     if(fd != -1) close(fd);
     return retval;
 }
+
+typedef struct
+{
+    size_t n;
+    atomic_size_t next;
+    void (*func)(size_t, void*);
+    void *arg;
+} parallel_t;
+
+// Workers are started on first use and live for the rest of the process.
+// parallel_for() posts one batch at a time, and every worker pulls indices from it until none are left.
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    // A new batch was posted
+    pthread_cond_t idle;    // The last worker left the current batch
+    parallel_t *cur;        // NULL once the caller is done with it
+    uint64_t gen;           // Bumped for every batch
+    size_t busy;            // Workers still working on `cur`
+    size_t nthr;
+} pool_t;
+
+static pool_t pool =
+{
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t pool_call = PTHREAD_MUTEX_INITIALIZER; // One batch at a time
+static _Thread_local bool pool_member = false;
+
+static void parallel_run(parallel_t *p)
+{
+    for(size_t i; (i = atomic_fetch_add(&p->next, 1)) < p->n; )
+    {
+        p->func(i, p->arg);
+    }
+}
+
+static void* pool_worker(void *a)
+{
+    (void)a;
+    pool_member = true;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool.lock);
+    while(true)
+    {
+        while(pool.gen == seen)
+        {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        seen = pool.gen;
+        parallel_t *p = pool.cur;
+        if(!p)
+        {
+            continue;
+        }
+        ++pool.busy;
+        pthread_mutex_unlock(&pool.lock);
+        parallel_run(p);
+        pthread_mutex_lock(&pool.lock);
+        if(--pool.busy == 0)
+        {
+            pthread_cond_signal(&pool.idle);
+        }
+    }
+    return NULL;
+}
+
+static void pool_init(void)
+{
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    for(long i = 1; i < ncpu; ++i)
+    {
+        pthread_t thr;
+        if(pthread_create(&thr, NULL, &pool_worker, NULL) != 0)
+        {
+            break;
+        }
+        pthread_detach(thr);
+        ++pool.nthr;
+    }
+}
+
+// Calls func(i, arg) for every i in [0, n), spread across a pool with one thread per CPU.
+// The calling thread participates, so if threads can't be created, this just degrades to a loop.
+// Calls from inside func run inline rather than waiting on the pool they're part of.
+void parallel_for(size_t n, void (*func)(size_t, void*), void *arg)
+{
+    parallel_t p =
+    {
+        .n    = n,
+        .next = 0,
+        .func = func,
+        .arg  = arg,
+    };
+    if(n > 1 && !pool_member)
+    {
+        pthread_once(&pool_once, &pool_init);
+    }
+    if(n <= 1 || pool_member || pool.nthr == 0)
+    {
+        parallel_run(&p);
+        return;
+    }
+    pthread_mutex_lock(&pool_call);
+    pthread_mutex_lock(&pool.lock);
+    pool.cur = &p;
+    ++pool.gen;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    pool_member = true;
+    parallel_run(&p);
+    pool_member = false;
+
+    // `p` lives on our stack, so no worker may still pick it up or be running it once we return
+    pthread_mutex_lock(&pool.lock);
+    pool.cur = NULL;
+    while(pool.busy > 0)
+    {
+        pthread_cond_wait(&pool.idle, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool_call);
+}
+
+void buf_printf(buf_t *b, const char *fmt, ...)
+{
+    if(b->oom)
+    {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(b->buf + b->len, b->cap - b->len, fmt, ap);
+    va_end(ap);
+    if(len < 0)
+    {
+        b->oom = true;
+        return;
+    }
+    if(b->len + len >= b->cap)
+    {
+        size_t cap = b->cap ? b->cap : 0x1000;
+        while(b->len + len >= cap) cap *= 2;
+        char *buf = realloc(b->buf, cap);
+        if(!buf)
+        {
+            b->oom = true;
+            return;
+        }
+        b->buf = buf;
+        b->cap = cap;
+        va_start(ap, fmt);
+        vsnprintf(b->buf + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+    }
+    b->len += len;
+}
+
+void buf_free(buf_t *b)
+{
+    if(b->buf) free(b->buf);
+    b->buf = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
@@ -11,8 +11,20 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdbool.h>
 #include <stddef.h>             // size_t
 
+typedef struct
+{
+    char *buf;
+    size_t len;
+    size_t cap;
+    bool oom;   // Sticky, set if any append failed
+} buf_t;
+
 int file2mem(const char *path, int (*func)(void*, size_t, void*), void *arg);
+void parallel_for(size_t n, void (*func)(size_t, void*), void *arg);
+void buf_printf(buf_t *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void buf_free(buf_t *b);
 
 #endif